@@ -0,0 +1,194 @@
+// Command round-trip latency against a running spheremon: publishes a
+// command on spheremon:command and times until its reply arrives on
+// spheremon:command:result:<cmd>.
+//
+// Build on any host with:
+//   cc -O2 -o cmd_latency cmd_latency.c
+// Usage: cmd_latency host port [password] [command] [iterations]
+//
+// To compare two spheremon builds, e.g. a fresh connection per reply
+// (d13509d) against the pipelined ReplyConnection_t (65a1881), run each
+// against the same local redis-server, with nothing else connected:
+//   redis-server --port 6390 --save "" &
+//   ./spheremon 127.0.0.1 6390 &
+//   ./cmd_latency 127.0.0.1 6390 "" message-count 10000
+// and record the p50/p99 line of each in the commit.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define LINE_MAX_LEN 4096
+
+typedef struct Conn
+{
+    int fd;
+    char buf[LINE_MAX_LEN];
+    size_t off, len;
+} Conn_t;
+
+static int dial(const char* host, const char* port)
+{
+    struct addrinfo hints, *res, *p;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res))
+        return -1;
+
+    int fd = -1;
+    for (p = res; p; p = p->ai_next)
+    {
+        if ((fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) < 0)
+            continue;
+        if (!connect(fd, p->ai_addr, p->ai_addrlen))
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    int one = 1;
+    if (fd >= 0)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+static bool readLine(Conn_t* c, char* line, size_t lineLen)
+{
+    size_t n = 0;
+    for (;;)
+    {
+        if (c->off == c->len)
+        {
+            ssize_t r = recv(c->fd, c->buf, sizeof c->buf, 0);
+            if (r <= 0)
+                return false;
+            c->off = 0;
+            c->len = (size_t)r;
+        }
+
+        char ch = c->buf[c->off++];
+        if (ch == '\n')
+        {
+            if (n && line[n - 1] == '\r')
+                n--;
+            line[n] = '\0';
+            return true;
+        }
+        if (n + 1 < lineLen)
+            line[n++] = ch;
+    }
+}
+
+// skips one RESP value; bulk payloads are assumed to fit a line
+static bool skipValue(Conn_t* c)
+{
+    char line[LINE_MAX_LEN];
+    if (!readLine(c, line, sizeof line))
+        return false;
+
+    long n = atol(line + 1);
+    switch (line[0])
+    {
+    case '$': return n < 0 || readLine(c, line, sizeof line);
+    case '*':
+    case '>':
+        for (long i = 0; i < n; i++)
+            if (!skipValue(c))
+                return false;
+        return true;
+    default: return true;
+    }
+}
+
+static bool sendAll(int fd, const char* s)
+{
+    size_t len = strlen(s);
+    while (len)
+    {
+        ssize_t w = send(fd, s, len, 0);
+        if (w <= 0)
+            return false;
+        s += w;
+        len -= (size_t)w;
+    }
+    return true;
+}
+
+static double nowUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmpDouble(const void* a, const void* b)
+{
+    double d = *(const double*)a - *(const double*)b;
+    return (d > 0) - (d < 0);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s host port [password] [command] [iterations]\n\n", argv[0]);
+        exit(-1);
+    }
+
+    const char* pass = argc > 3 && *argv[3] ? argv[3] : NULL;
+    const char* cmd = argc > 4 ? argv[4] : "message-count";
+    int iterations = argc > 5 ? atoi(argv[5]) : 1000;
+    char req[512];
+
+    Conn_t sub = { .fd = dial(argv[1], argv[2]) }, pub = { .fd = dial(argv[1], argv[2]) };
+    if (sub.fd < 0 || pub.fd < 0 || iterations < 1)
+    {
+        fprintf(stderr, "connect to %s:%s failed\n", argv[1], argv[2]);
+        exit(1);
+    }
+
+    if (pass)
+    {
+        snprintf(req, sizeof req, "AUTH %s\r\n", pass);
+        if (!sendAll(sub.fd, req) || !skipValue(&sub) || !sendAll(pub.fd, req) || !skipValue(&pub))
+            exit(1);
+    }
+
+    snprintf(req, sizeof req, "SUBSCRIBE spheremon:command:result:%s\r\n", cmd);
+    if (!sendAll(sub.fd, req) || !skipValue(&sub))
+        exit(1);
+
+    double* samples = (double*)malloc(sizeof(double) * iterations);
+    snprintf(req, sizeof req, "PUBLISH spheremon:command %s\r\n", cmd);
+    for (int i = 0; i < iterations; i++)
+    {
+        double start = nowUs();
+        if (!sendAll(pub.fd, req) || !skipValue(&pub) || !skipValue(&sub))
+        {
+            fprintf(stderr, "connection lost after %d iterations\n", i);
+            exit(1);
+        }
+        samples[i] = nowUs() - start;
+    }
+
+    qsort(samples, iterations, sizeof(double), cmpDouble);
+    double sum = 0;
+    for (int i = 0; i < iterations; i++)
+        sum += samples[i];
+
+    printf("%d x '%s': avg %.1fus p50 %.1fus p99 %.1fus max %.1fus\n", iterations, cmd,
+        sum / iterations, samples[iterations / 2], samples[(int)(iterations * 0.99)], samples[iterations - 1]);
+
+    free(samples);
+    return 0;
+}
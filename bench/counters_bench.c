@@ -0,0 +1,113 @@
+// Increment throughput of spheremon's counter layouts under concurrent
+// writers and readers. Compares:
+//   legacy   adjacent plain ints, as the old msgCount/lastLost/threadRunningCount globals
+//   shared   one atomic counter every writer fetch_adds
+//   padded   counters.h: one cache-line padded single-writer counter per writer
+//
+// Each writer stands for one of spheremon's counters (msgCount, lastLost), so
+// the default is two writers; more show how the layouts scale.
+//
+// Build on any host with:
+//   cc -O2 -std=gnu11 -I../spheremon -o counters_bench counters_bench.c -lpthread
+// Usage: counters_bench [writers] [readers] [seconds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "counters.h"
+
+typedef enum { Layout_Legacy, Layout_Shared, Layout_Padded, Layout_Count } Layout_t;
+static const char* layoutNames[Layout_Count] = { "legacy", "shared", "padded" };
+
+#define MAX_WRITERS 16
+
+static volatile int legacy[MAX_WRITERS];
+static _Atomic int64_t shared;
+static Counter_t padded[MAX_WRITERS];
+static int writers;
+
+static _Atomic bool stop;
+static Layout_t layout;
+
+static void* writerFunc(void* arg)
+{
+    int w = (int)(intptr_t)arg;
+    uint64_t n = 0;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed))
+    {
+        for (int i = 0; i < 1024; i++)
+        {
+            switch (layout)
+            {
+            case Layout_Legacy: ++legacy[w]; break;
+            case Layout_Shared: atomic_fetch_add_explicit(&shared, 1, memory_order_relaxed); break;
+            default: Counter_add(&padded[w], 1); break;
+            }
+        }
+        n += 1024;
+    }
+    return (void*)(uintptr_t)n;
+}
+
+static void* readerFunc(void* arg)
+{
+    (void)arg;
+    int64_t sink = 0;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed))
+    {
+        switch (layout)
+        {
+        case Layout_Legacy: for (int w = 0; w < writers; w++) sink += legacy[w]; break;
+        case Layout_Shared: sink += atomic_load_explicit(&shared, memory_order_acquire); break;
+        default: for (int w = 0; w < writers; w++) sink += Counter_read(&padded[w]); break;
+        }
+    }
+    return (void*)(intptr_t)sink;
+}
+
+int main(int argc, char** argv)
+{
+    writers = argc > 1 ? atoi(argv[1]) : 2;
+    int readers = argc > 2 ? atoi(argv[2]) : 2;
+    int seconds = argc > 3 ? atoi(argv[3]) : 2;
+
+    if (writers < 1 || writers > MAX_WRITERS || readers < 0 || seconds < 1)
+    {
+        fprintf(stderr, "Usage: %s [writers 1-%d] [readers] [seconds]\n\n", argv[0], MAX_WRITERS);
+        exit(-1);
+    }
+
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * (writers + readers));
+    const struct timespec runTime = { seconds, 0 };
+
+    printf("%d writers, %d readers, %ds per layout\n", writers, readers, seconds);
+    for (layout = Layout_Legacy; layout < Layout_Count; layout++)
+    {
+        atomic_store(&stop, false);
+        for (int i = 0; i < writers; i++)
+            pthread_create(&threads[i], NULL, writerFunc, (void*)(intptr_t)i);
+        for (int i = 0; i < readers; i++)
+            pthread_create(&threads[writers + i], NULL, readerFunc, NULL);
+
+        nanosleep(&runTime, NULL);
+        atomic_store(&stop, true);
+
+        uint64_t total = 0;
+        for (int i = 0; i < writers + readers; i++)
+        {
+            void* ret;
+            pthread_join(threads[i], &ret);
+            if (i < writers)
+                total += (uint64_t)(uintptr_t)ret;
+        }
+
+        printf("%-7s %10.2f M increments/s\n", layoutNames[layout], total / 1e6 / seconds);
+    }
+
+    free(threads);
+    return 0;
+}
@@ -0,0 +1,559 @@
+// Pub/sub throughput harness: finds the message rate at which spheremon's
+// activity path stops keeping up. Against a running local redis-server it
+// starts spheremon (the host build, see CMakeLists.txt), then for each
+// offered rate runs pubsub_load for a fixed time and measures:
+//   sustained   messages spheremon counted per second of load (message-count)
+//   latency     send-to-processed percentiles (activity-latency; needs a
+//               spheremon built with ACTIVITY_LATENCY_PROBE, as the host build is)
+//   cpu         spheremon's user+system time per processed message, from
+//               /proc/<pid>/stat, so it includes every thread
+//   dropped     whether redis closed the activity subscriber, seen as its
+//               CLIENT LIST entry going away or changing id; the peak output
+//               buffer it reached is sampled every 100ms
+// A step keeps up when nothing was dropped and spheremon had processed at
+// least 95% of what was sent by the time the load stopped. Everything goes
+// out as one JSON document for regression tracking.
+//
+// Build with the host build, or on any host with:
+//   cc -O2 -std=gnu11 -o pubsub_bench pubsub_bench.c
+// Usage: pubsub_bench [-S spheremon | -P pid] [-L pubsub_load] [-r rate,rate,...]
+//                     [-d seconds] [-t threads] [-c channels] [-p payload-bytes]
+//                     [-s shape] [-o out.json] host port
+// spheremon and pubsub_load default to the ones beside this program; rate 0
+// is flat out.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define LINE_MAX_LEN 65536
+#define RATES_MAX 32
+#define SAMPLE_MS 100
+#define READY_TIMEOUT_MS 30000
+#define DRAIN_TIMEOUT_MS 5000
+#define RESUBSCRIBE_TIMEOUT_MS 15000
+#define KEEP_UP_FRACTION 0.95
+
+typedef struct Conn
+{
+    int fd;
+    char buf[LINE_MAX_LEN];
+    size_t off, len;
+} Conn_t;
+
+typedef struct Subscriber
+{
+    long long id;                   // 0 when there's none
+    long long omem;
+} Subscriber_t;
+
+typedef struct Step
+{
+    double offered;
+    char load[1024];                // pubsub_load's own JSON
+    long long sent;
+    long long processed;            // by the time the load stopped
+    long long drained;              // once the count stopped moving
+    double loadSeconds;
+    double wallSeconds;             // load plus drain, which cpuSeconds covers
+    double cpuSeconds;
+    char latency[256];
+    bool dropped;
+    long long peakOmem;
+    bool keptUp;
+} Step_t;
+
+static uint64_t nowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void sleepMs(unsigned ms)
+{
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000 };
+    nanosleep(&ts, NULL);
+}
+
+static int dial(const char* host, const char* port)
+{
+    struct addrinfo hints, *res, *p;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res))
+        return -1;
+
+    int fd = -1;
+    for (p = res; p; p = p->ai_next)
+    {
+        if ((fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) < 0)
+            continue;
+        if (!connect(fd, p->ai_addr, p->ai_addrlen))
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    int one = 1;
+    if (fd >= 0)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+static bool sendAll(int fd, const char* s)
+{
+    size_t len = strlen(s);
+    while (len)
+    {
+        ssize_t w = send(fd, s, len, MSG_NOSIGNAL);
+        if (w <= 0)
+            return false;
+        s += w;
+        len -= (size_t)w;
+    }
+    return true;
+}
+
+static bool readLine(Conn_t* c, char* line, size_t lineLen)
+{
+    size_t n = 0;
+    for (;;)
+    {
+        if (c->off == c->len)
+        {
+            ssize_t r = recv(c->fd, c->buf, sizeof c->buf, 0);
+            if (r <= 0)
+                return false;
+            c->off = 0;
+            c->len = (size_t)r;
+        }
+
+        char ch = c->buf[c->off++];
+        if (ch == '\n')
+        {
+            if (n && line[n - 1] == '\r')
+                n--;
+            line[n] = '\0';
+            return true;
+        }
+        if (n + 1 < lineLen)
+            line[n++] = ch;
+    }
+}
+
+// n bytes, of which the first outLen - 1 are kept; bulk strings such as
+// CLIENT LIST's can hold newlines, so they're read by length, not by line
+static bool readBytes(Conn_t* c, size_t n, char* out, size_t outLen)
+{
+    size_t kept = 0;
+    while (n)
+    {
+        if (c->off == c->len)
+        {
+            ssize_t r = recv(c->fd, c->buf, sizeof c->buf, 0);
+            if (r <= 0)
+                return false;
+            c->off = 0;
+            c->len = (size_t)r;
+        }
+
+        size_t chunk = c->len - c->off < n ? c->len - c->off : n;
+        size_t keep = kept + chunk < outLen ? chunk : outLen - 1 - kept;
+        memcpy(out + kept, c->buf + c->off, keep);
+        kept += keep;
+        c->off += chunk;
+        n -= chunk;
+    }
+    out[kept] = '\0';
+    return true;
+}
+
+// reads one RESP2 reply, keeping the last string or integer seen (for arrays,
+// the last element) in out
+static bool readReply(Conn_t* c, char* out, size_t outLen)
+{
+    char line[LINE_MAX_LEN];
+    if (!readLine(c, line, sizeof line))
+        return false;
+
+    long n = atol(line + 1);
+    switch (line[0])
+    {
+    case '$':
+    {
+        char crlf[3];
+        if (n < 0)
+        {
+            out[0] = '\0';
+            return true;
+        }
+        return readBytes(c, (size_t)n, out, outLen) && readBytes(c, 2, crlf, sizeof crlf);
+    }
+    case '*':
+        for (long i = 0; i < n; i++)
+            if (!readReply(c, out, outLen))
+                return false;
+        return true;
+    default:
+        snprintf(out, outLen, "%s", line + 1);
+        return line[0] != '-';
+    }
+}
+
+static bool command(Conn_t* c, const char* cmd, char* out, size_t outLen)
+{
+    char req[512];
+    snprintf(req, sizeof req, "%s\r\n", cmd);
+    return sendAll(c->fd, req) && readReply(c, out, outLen);
+}
+
+// runs a spheremon command over pub/sub: publishes it and waits for its
+// result on the pattern subscription sub already holds
+static bool query(Conn_t* ctl, Conn_t* sub, const char* cmd, char* out, size_t outLen)
+{
+    char req[512], ack[64];
+    snprintf(req, sizeof req, "PUBLISH spheremon:command \"%s\"", cmd);
+    if (!command(ctl, req, ack, sizeof ack) || !atoi(ack))
+        return false;
+
+    // pmessage, pattern, channel, payload: the channel ends with the command
+    struct pollfd pfd = { .fd = sub->fd, .events = POLLIN };
+    for (uint64_t deadline = nowMs() + 2000; nowMs() < deadline;)
+    {
+        if (sub->off == sub->len && poll(&pfd, 1, (int)(deadline - nowMs())) <= 0)
+            return false;
+
+        char line[LINE_MAX_LEN], channel[512] = "";
+        if (!readLine(sub, line, sizeof line) || line[0] != '*')
+            return false;
+        long items = atol(line + 1);
+        for (long i = 0; i < items; i++)
+            if (!readReply(sub, i == 3 ? out : channel, i == 3 ? outLen : sizeof channel))
+                return false;
+
+        // reply channels are spheremon:command:result:<command as sent>
+        size_t chLen = strlen(channel), cmdLen = strlen(cmd);
+        if (items == 4 && chLen >= cmdLen && !strcmp(channel + chLen - cmdLen, cmd))
+            return true;
+    }
+    return false;
+}
+
+// spheremon's activity subscriber: the pattern subscriber that isn't us
+static Subscriber_t findSubscriber(Conn_t* ctl, long long selfId)
+{
+    static char list[LINE_MAX_LEN];
+    Subscriber_t found = { 0, 0 };
+    if (!command(ctl, "CLIENT LIST TYPE pubsub", list, sizeof list))
+        return found;
+
+    for (char* line = strtok(list, "\n"); line; line = strtok(NULL, "\n"))
+    {
+        char* id = strstr(line, "id=");
+        char* psub = strstr(line, " psub=");
+        char* omem = strstr(line, " omem=");
+        long long clientId = id ? atoll(id + 3) : 0;
+        if (clientId && clientId != selfId && psub && atoi(psub + 6) > 0)
+        {
+            found.id = clientId;
+            found.omem = omem ? atoll(omem + 6) : 0;
+        }
+    }
+    return found;
+}
+
+static double cpuSeconds(pid_t pid)
+{
+    char path[64], stat[1024];
+    snprintf(path, sizeof path, "/proc/%d/stat", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (!f)
+        return 0;
+    size_t n = fread(stat, 1, sizeof stat - 1, f);
+    fclose(f);
+    stat[n] = '\0';
+
+    // fields 14 and 15 (utime, stime), counted from after the parenthesised name
+    char* p = strrchr(stat, ')');
+    unsigned long long utime = 0, stime = 0;
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2)
+        return 0;
+    return (double)(utime + stime) / (double)sysconf(_SC_CLK_TCK);
+}
+
+static long long messageCount(Conn_t* ctl, Conn_t* sub)
+{
+    char out[64];
+    return query(ctl, sub, "message-count", out, sizeof out) ? atoll(out) : -1;
+}
+
+// the program beside this one, when path wasn't given
+static const char* sibling(const char* argv0, const char* name, char* buf, size_t bufLen)
+{
+    const char* slash = strrchr(argv0, '/');
+    snprintf(buf, bufLen, "%.*s%s", slash ? (int)(slash - argv0 + 1) : 0, argv0, name);
+    return buf;
+}
+
+static pid_t spawn(char* const* args, int outFd)
+{
+    pid_t pid = fork();
+    if (pid)
+        return pid;
+
+    int null = open("/dev/null", O_RDWR);
+    dup2(null, STDIN_FILENO);
+    dup2(outFd >= 0 ? outFd : null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    execv(args[0], args);
+    _exit(127);
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [-S spheremon | -P pid] [-L pubsub_load] [-r rate,rate,...] [-d seconds]\n"
+        "       [-t threads] [-c channels] [-p payload-bytes] [-s shape] [-o out.json] host port\n\n", argv0);
+    exit(-1);
+}
+
+static void writeJson(FILE* f, const char* host, const char* port, const char* obufLimit, const char* params,
+    Step_t* steps, int stepCount)
+{
+    double best = 0;
+    const Step_t* fell = NULL;
+    for (int i = 0; i < stepCount; i++)
+    {
+        double sustained = steps[i].loadSeconds > 0 ? steps[i].processed / steps[i].loadSeconds : 0;
+        if (steps[i].keptUp && sustained > best)
+            best = sustained;
+        if (!steps[i].keptUp && !fell)
+            fell = &steps[i];
+    }
+
+    fprintf(f, "{\n  \"redis\": \"%s:%s\",\n  \"client_output_buffer_limit\": \"%s\",\n  \"load\": %s,\n"
+        "  \"max_sustained_rate\": %.1f,\n", host, port, obufLimit, params, best);
+    if (fell)
+        fprintf(f, "  \"falls_over_at\": %.0f,\n", fell->offered);
+    else
+        fprintf(f, "  \"falls_over_at\": null,\n");
+    fprintf(f, "  \"steps\": [\n");
+
+    for (int i = 0; i < stepCount; i++)
+    {
+        Step_t* s = &steps[i];
+        unsigned long long count = 0, p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+        bool probed = sscanf(s->latency, "count=%llu p50=%lluus p90=%lluus p99=%lluus p999=%lluus max=%lluus",
+            &count, &p50, &p90, &p99, &p999, &max) == 6;
+
+        fprintf(f, "    {\"offered_rate\": %.0f, \"generator\": %s, \"processed\": %lld, \"drained\": %lld, "
+            "\"backlog_at_stop\": %lld, \"sustained_rate\": %.1f, ",
+            s->offered, s->load[0] ? s->load : "null", s->processed, s->drained,
+            s->sent - s->processed, s->loadSeconds > 0 ? s->processed / s->loadSeconds : 0);
+        if (probed)
+            fprintf(f, "\"latency_us\": {\"count\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, "
+                "\"p999\": %llu, \"max\": %llu}, ", count, p50, p90, p99, p999, max);
+        else
+            fprintf(f, "\"latency_us\": null, ");
+        fprintf(f, "\"cpu_percent\": %.1f, \"cpu_us_per_msg\": %.3f, \"subscriber_dropped\": %s, "
+            "\"peak_omem_bytes\": %lld, \"kept_up\": %s}%s\n",
+            s->wallSeconds > 0 ? 100 * s->cpuSeconds / s->wallSeconds : 0,
+            s->drained > 0 ? 1e6 * s->cpuSeconds / s->drained : 0,
+            s->dropped ? "true" : "false", s->peakOmem, s->keptUp ? "true" : "false",
+            i + 1 < stepCount ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    char spheremonBuf[4096], loadBuf[4096];
+    const char* spheremon = NULL;
+    const char* loadPath = NULL;
+    const char* rates = "1000,5000,10000,25000,50000,100000,0";
+    const char* outPath = NULL;
+    const char* seconds = "5";
+    const char* threads = "4";
+    const char* channels = "16";
+    const char* payload = "64";
+    const char* shape = "steady";
+    pid_t pid = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "S:P:L:r:d:t:c:p:s:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'S': spheremon = optarg; break;
+        case 'P': pid = (pid_t)atoi(optarg); break;
+        case 'L': loadPath = optarg; break;
+        case 'r': rates = optarg; break;
+        case 'd': seconds = optarg; break;
+        case 't': threads = optarg; break;
+        case 'c': channels = optarg; break;
+        case 'p': payload = optarg; break;
+        case 's': shape = optarg; break;
+        case 'o': outPath = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2)
+        usage(argv[0]);
+    char* host = argv[optind];
+    char* port = argv[optind + 1];
+    if (!spheremon)
+        spheremon = sibling(argv[0], "spheremon", spheremonBuf, sizeof spheremonBuf);
+    if (!loadPath)
+        loadPath = sibling(argv[0], "pubsub_load", loadBuf, sizeof loadBuf);
+
+    double offered[RATES_MAX];
+    int stepCount = 0;
+    char ratesCopy[512];
+    snprintf(ratesCopy, sizeof ratesCopy, "%s", rates);
+    for (char* r = strtok(ratesCopy, ","); r && stepCount < RATES_MAX; r = strtok(NULL, ","))
+        offered[stepCount++] = atof(r);
+
+    static Conn_t ctl, sub;
+    char out[LINE_MAX_LEN];
+    if ((ctl.fd = dial(host, port)) < 0 || (sub.fd = dial(host, port)) < 0)
+    {
+        fprintf(stderr, "connect to %s:%s failed\n", host, port);
+        exit(1);
+    }
+    char obufLimit[256] = "";
+    if (command(&ctl, "CONFIG GET client-output-buffer-limit", out, sizeof out))
+        snprintf(obufLimit, sizeof obufLimit, "%.*s", (int)sizeof obufLimit - 1, out);
+    if (!command(&sub, "CLIENT ID", out, sizeof out))
+        exit(1);
+    long long selfId = atoll(out);
+    if (!command(&sub, "PSUBSCRIBE spheremon:command:result:*", out, sizeof out))
+        exit(1);
+
+    bool started = !pid;
+    if (started)
+    {
+        char* args[] = { (char*)spheremon, host, port, NULL };
+        pid = spawn(args, -1);
+    }
+
+    // up once it answers commands and its activity subscriber is in place
+    uint64_t deadline = nowMs() + READY_TIMEOUT_MS;
+    while ((messageCount(&ctl, &sub) < 0 || !findSubscriber(&ctl, selfId).id) && nowMs() < deadline)
+        sleepMs(SAMPLE_MS);
+    if (nowMs() >= deadline || kill(pid, 0))
+    {
+        fprintf(stderr, "spheremon (%s) never came up\n", started ? spheremon : "pid");
+        if (started)
+            kill(pid, SIGTERM);
+        exit(1);
+    }
+
+    Step_t steps[RATES_MAX];
+    memset(steps, 0, sizeof steps);
+    for (int i = 0; i < stepCount; i++)
+    {
+        Step_t* s = &steps[i];
+        s->offered = offered[i];
+        fprintf(stderr, "offering %.0f msg/s for %ss...\n", s->offered, seconds);
+
+        Subscriber_t before = findSubscriber(&ctl, selfId);
+        query(&ctl, &sub, "activity-latency reset", out, sizeof out);
+        long long count0 = messageCount(&ctl, &sub);
+        double cpu0 = cpuSeconds(pid);
+        uint64_t t0 = nowMs();
+
+        char rate[32];
+        snprintf(rate, sizeof rate, "%.0f", s->offered);
+        char* args[] = { (char*)loadPath, "-t", (char*)threads, "-c", (char*)channels, "-p", (char*)payload,
+            "-r", rate, "-d", (char*)seconds, "-s", (char*)shape, host, port, NULL };
+        int pipeFds[2];
+        if (pipe(pipeFds))
+            exit(1);
+        pid_t loadPid = spawn(args, pipeFds[1]);
+        close(pipeFds[1]);
+
+        // watch the subscriber's output buffer until the generator exits
+        int status = 0;
+        s->peakOmem = before.omem;
+        while (waitpid(loadPid, &status, WNOHANG) == 0)
+        {
+            Subscriber_t now = findSubscriber(&ctl, selfId);
+            if (now.id != before.id)
+                s->dropped = true;
+            else if (now.omem > s->peakOmem)
+                s->peakOmem = now.omem;
+            sleepMs(SAMPLE_MS);
+        }
+        s->loadSeconds = (nowMs() - t0) / 1000.0;
+        long long count1 = messageCount(&ctl, &sub);
+
+        ssize_t n = read(pipeFds[0], s->load, sizeof s->load - 1);
+        close(pipeFds[0]);
+        s->load[n > 0 ? n : 0] = '\0';
+        s->load[strcspn(s->load, "\n")] = '\0';
+        char* sent = strstr(s->load, "\"sent\":");
+        s->sent = sent ? atoll(sent + 7) : 0;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) == 127)
+            fprintf(stderr, "  %s failed to run\n", loadPath);
+
+        // let spheremon work through what redis had buffered
+        long long last = count1, settled = count1;
+        for (uint64_t drainEnd = nowMs() + DRAIN_TIMEOUT_MS; nowMs() < drainEnd; last = settled)
+        {
+            sleepMs(SAMPLE_MS * 2);
+            if ((settled = messageCount(&ctl, &sub)) <= last)
+                break;
+        }
+        s->cpuSeconds = cpuSeconds(pid) - cpu0;
+        s->wallSeconds = (nowMs() - t0) / 1000.0;
+        s->processed = count0 >= 0 && count1 >= 0 ? count1 - count0 : 0;
+        s->drained = count0 >= 0 && last >= 0 ? last - count0 : 0;
+        if (findSubscriber(&ctl, selfId).id != before.id)
+            s->dropped = true;
+        if (query(&ctl, &sub, "activity-latency", out, sizeof out))
+            snprintf(s->latency, sizeof s->latency, "%.*s", (int)sizeof s->latency - 1, out);
+        s->keptUp = !s->dropped && s->sent > 0 && s->processed >= KEEP_UP_FRACTION * s->sent;
+        fprintf(stderr, "  sent %lld, processed %lld (%.0f msg/s)%s\n", s->sent, s->processed,
+            s->processed / s->loadSeconds, s->dropped ? ", subscriber dropped" : "");
+
+        // a dropped subscriber comes back through spheremon's reconnect backoff
+        if (s->dropped)
+            for (uint64_t end = nowMs() + RESUBSCRIBE_TIMEOUT_MS; !findSubscriber(&ctl, selfId).id && nowMs() < end;)
+                sleepMs(SAMPLE_MS);
+    }
+
+    if (started)
+    {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+
+    char params[512];
+    snprintf(params, sizeof params, "{\"threads\": %s, \"channels\": %s, \"payload_bytes\": %s, \"shape\": \"%s\", "
+        "\"seconds\": %s}", threads, channels, payload, shape, seconds);
+    FILE* f = outPath ? fopen(outPath, "w") : stdout;
+    if (!f)
+    {
+        perror(outPath);
+        exit(1);
+    }
+    writeJson(f, host, port, obufLimit, params, steps, stepCount);
+    if (f != stdout)
+        fclose(f);
+    return 0;
+}
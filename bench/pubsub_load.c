@@ -0,0 +1,334 @@
+// Pub/sub load generator: publishes from several threads, one connection
+// each, round-robin over a set of channels, at a target rate with a chosen
+// burst shape. Every payload starts with LATENCY_PROBE_TAG and its send time
+// (see spheremon/lathist.h), so a spheremon built with ACTIVITY_LATENCY_PROBE
+// can time it. Prints one JSON object describing what was actually sent.
+// Used by pubsub_bench, but runs fine on its own.
+//
+// Shapes, all averaging the target rate over the run:
+//   steady             evenly paced
+//   burst:<on>/<off>   on ms at (on + off) / on times the rate, then off ms idle
+//   ramp               rising linearly from 0 to twice the rate
+//
+// Build on any host with:
+//   cc -O2 -std=gnu11 -I../spheremon -o pubsub_load pubsub_load.c -lpthread
+// Usage: pubsub_load [-a password] [-t threads] [-c channels] [-p payload-bytes]
+//                    [-r msgs-per-sec, 0 = flat out] [-d seconds] [-s shape] host port
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "lathist.h"
+
+#define BATCH_MAX 64                // PUBLISHes per write, replies read after
+#define PAYLOAD_MAX 65536
+#define IDLE_NS 100000
+
+typedef enum { Shape_Steady, Shape_Burst, Shape_Ramp } Shape_t;
+
+typedef struct Options
+{
+    const char* host;
+    const char* port;
+    const char* pass;
+    int threads;
+    int channels;
+    int payloadBytes;
+    double rate;                    // total; 0 is flat out
+    double seconds;
+    Shape_t shape;
+    double onSeconds, offSeconds;   // burst
+    const char* shapeName;
+} Options_t;
+
+typedef struct Publisher
+{
+    const Options_t* opts;
+    int index;
+    int fd;
+    char rbuf[4096];
+    size_t roff, rlen;
+    uint64_t sent;
+    uint64_t deliveries;            // sum of PUBLISH replies: subscribers reached
+    uint64_t errors;
+    bool disconnected;
+    pthread_t thread;
+} Publisher_t;
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int dial(const char* host, const char* port)
+{
+    struct addrinfo hints, *res, *p;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res))
+        return -1;
+
+    int fd = -1;
+    for (p = res; p; p = p->ai_next)
+    {
+        if ((fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) < 0)
+            continue;
+        if (!connect(fd, p->ai_addr, p->ai_addrlen))
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    int one = 1;
+    if (fd >= 0)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+static bool sendAll(int fd, const char* s, size_t len)
+{
+    while (len)
+    {
+        ssize_t w = send(fd, s, len, MSG_NOSIGNAL);
+        if (w <= 0)
+            return false;
+        s += w;
+        len -= (size_t)w;
+    }
+    return true;
+}
+
+// one reply line; PUBLISH and AUTH replies are never more than that
+static bool readLine(Publisher_t* p, char* line, size_t lineLen)
+{
+    size_t n = 0;
+    for (;;)
+    {
+        if (p->roff == p->rlen)
+        {
+            ssize_t r = recv(p->fd, p->rbuf, sizeof p->rbuf, 0);
+            if (r <= 0)
+                return false;
+            p->roff = 0;
+            p->rlen = (size_t)r;
+        }
+
+        char ch = p->rbuf[p->roff++];
+        if (ch == '\n')
+        {
+            if (n && line[n - 1] == '\r')
+                n--;
+            line[n] = '\0';
+            return true;
+        }
+        if (n + 1 < lineLen)
+            line[n++] = ch;
+    }
+}
+
+// messages this thread should have sent after elapsed seconds
+static double target(const Options_t* o, double rate, double elapsed)
+{
+    switch (o->shape)
+    {
+    case Shape_Burst:
+    {
+        double cycle = o->onSeconds + o->offSeconds;
+        double whole = (double)(uint64_t)(elapsed / cycle);
+        double into = elapsed - whole * cycle;
+        double on = whole * o->onSeconds + (into < o->onSeconds ? into : o->onSeconds);
+        return on * rate * cycle / o->onSeconds;
+    }
+    case Shape_Ramp:
+        return rate * elapsed * elapsed / o->seconds;
+    default:
+        return rate * elapsed;
+    }
+}
+
+static void* publisherFunc(void* arg)
+{
+    Publisher_t* p = (Publisher_t*)arg;
+    const Options_t* o = p->opts;
+    double rate = o->rate / o->threads;
+    size_t cmdMax = (size_t)o->payloadBytes + 128;
+    char* batch = (char*)malloc(cmdMax * BATCH_MAX);
+    char* payload = (char*)malloc((size_t)o->payloadBytes + 1);
+    memset(payload, 'x', (size_t)o->payloadBytes);
+    payload[o->payloadBytes] = '\0';
+
+    uint64_t start = nowNs(), end = start + (uint64_t)(o->seconds * 1e9);
+    uint64_t channel = (uint64_t)p->index;
+    char line[256];
+
+    for (uint64_t now = start; now < end && !p->disconnected; now = nowNs())
+    {
+        uint64_t due = BATCH_MAX;
+        if (rate > 0)
+        {
+            double want = target(o, rate, (now - start) / 1e9) - (double)p->sent;
+            if (want < 1)
+            {
+                struct timespec idle = { 0, IDLE_NS };
+                nanosleep(&idle, NULL);
+                continue;
+            }
+            due = want < BATCH_MAX ? (uint64_t)want : BATCH_MAX;
+        }
+
+        size_t len = 0;
+        for (uint64_t i = 0; i < due; i++, channel += (uint64_t)o->threads)
+        {
+            // the tag and time overwrite the front of the filler, keeping the size
+            int tagLen = snprintf(payload, (size_t)o->payloadBytes + 1, LATENCY_PROBE_TAG "%llu ",
+                (unsigned long long)nowNs());
+            if (tagLen < o->payloadBytes)
+                payload[tagLen] = 'x';
+
+            char chan[32];
+            int chanLen = snprintf(chan, sizeof chan, "bench:%llu", (unsigned long long)(channel % (uint64_t)o->channels));
+            len += (size_t)snprintf(batch + len, cmdMax, "*3\r\n$7\r\nPUBLISH\r\n$%d\r\n%s\r\n$%d\r\n%s\r\n",
+                chanLen, chan, o->payloadBytes, payload);
+        }
+
+        if (!sendAll(p->fd, batch, len))
+        {
+            p->disconnected = true;
+            break;
+        }
+        for (uint64_t i = 0; i < due; i++)
+        {
+            if (!readLine(p, line, sizeof line))
+            {
+                p->disconnected = true;
+                break;
+            }
+            if (line[0] == ':')
+                p->deliveries += strtoull(line + 1, NULL, 10);
+            else
+                p->errors++;
+            p->sent++;
+        }
+    }
+
+    free(payload);
+    free(batch);
+    return NULL;
+}
+
+static bool parseShape(const char* s, Options_t* o)
+{
+    o->shapeName = s;
+    if (!strcmp(s, "steady"))
+        o->shape = Shape_Steady;
+    else if (!strcmp(s, "ramp"))
+        o->shape = Shape_Ramp;
+    else
+    {
+        unsigned on, off;
+        if (sscanf(s, "burst:%u/%u", &on, &off) != 2 || !on)
+            return false;
+        o->shape = Shape_Burst;
+        o->onSeconds = on / 1000.0;
+        o->offSeconds = off / 1000.0;
+    }
+    return true;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [-a password] [-t threads] [-c channels] [-p payload-bytes]\n"
+        "       [-r msgs-per-sec, 0 = flat out] [-d seconds] [-s steady|burst:<on-ms>/<off-ms>|ramp] host port\n\n",
+        argv0);
+    exit(-1);
+}
+
+int main(int argc, char** argv)
+{
+    Options_t o = { .threads = 4, .channels = 16, .payloadBytes = 64, .rate = 10000, .seconds = 5,
+        .shape = Shape_Steady, .shapeName = "steady" };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:t:c:p:r:d:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a': o.pass = optarg; break;
+        case 't': o.threads = atoi(optarg); break;
+        case 'c': o.channels = atoi(optarg); break;
+        case 'p': o.payloadBytes = atoi(optarg); break;
+        case 'r': o.rate = atof(optarg); break;
+        case 'd': o.seconds = atof(optarg); break;
+        case 's':
+            if (!parseShape(optarg, &o))
+                usage(argv[0]);
+            break;
+        default: usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2 || o.threads < 1 || o.channels < 1 || o.seconds <= 0 || o.rate < 0
+        || o.payloadBytes < (int)sizeof(LATENCY_PROBE_TAG) + 20 || o.payloadBytes > PAYLOAD_MAX)
+        usage(argv[0]);
+    o.host = argv[optind];
+    o.port = argv[optind + 1];
+
+    Publisher_t* pubs = (Publisher_t*)calloc((size_t)o.threads, sizeof(Publisher_t));
+    for (int i = 0; i < o.threads; i++)
+    {
+        pubs[i].opts = &o;
+        pubs[i].index = i;
+        if ((pubs[i].fd = dial(o.host, o.port)) < 0)
+        {
+            fprintf(stderr, "connect to %s:%s failed\n", o.host, o.port);
+            exit(1);
+        }
+
+        char req[512], line[256];
+        snprintf(req, sizeof req, "AUTH %s\r\n", o.pass ? o.pass : "");
+        if (o.pass && (!sendAll(pubs[i].fd, req, strlen(req)) || !readLine(&pubs[i], line, sizeof line) || line[0] != '+'))
+        {
+            fprintf(stderr, "AUTH failed\n");
+            exit(1);
+        }
+    }
+
+    uint64_t start = nowNs();
+    for (int i = 0; i < o.threads; i++)
+        pthread_create(&pubs[i].thread, NULL, publisherFunc, &pubs[i]);
+
+    uint64_t sent = 0, deliveries = 0, errors = 0;
+    bool disconnected = false;
+    for (int i = 0; i < o.threads; i++)
+    {
+        pthread_join(pubs[i].thread, NULL);
+        close(pubs[i].fd);
+        sent += pubs[i].sent;
+        deliveries += pubs[i].deliveries;
+        errors += pubs[i].errors;
+        disconnected |= pubs[i].disconnected;
+    }
+    double seconds = (nowNs() - start) / 1e9;
+
+    printf("{\"threads\":%d,\"channels\":%d,\"payload_bytes\":%d,\"shape\":\"%s\",\"target_rate\":%.0f,"
+        "\"seconds\":%.3f,\"sent\":%llu,\"rate\":%.1f,\"deliveries\":%llu,\"errors\":%llu,\"disconnected\":%s}\n",
+        o.threads, o.channels, o.payloadBytes, o.shapeName, o.rate, seconds, (unsigned long long)sent,
+        sent / seconds, (unsigned long long)deliveries, (unsigned long long)errors, disconnected ? "true" : "false");
+
+    free(pubs);
+    return disconnected || errors ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+// Shutdown latency with spheremon's shutdown path (shutdown.h). Stand-ins
+// for each kind of thread are left where the real ones spend their time:
+// blocked reading a quiet subscription socket (activity, command, command
+// stream, sentinel watcher), in a long backoff or cadence sleep (reconnect,
+// sweep), and in a poll() loop (extra targets). The main thread sleeps out
+// its cadence, then SIGTERM arrives and the time until every thread has been
+// joined is measured, over several rounds. Fails if any round takes longer
+// than the bound.
+//
+// Build on any host with:
+//   cc -O2 -std=gnu11 -I../spheremon -o shutdown_latency shutdown_latency.c ../spheremon/shutdown.c -lpthread
+// Usage: shutdown_latency [rounds] [bound-ms]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "shutdown.h"
+
+#define READERS 4
+#define SLEEPERS 2
+
+static volatile sig_atomic_t running;
+
+static double nowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void onTerm(int sig)
+{
+    (void)sig;
+    Shutdown_request();
+}
+
+// a subscriber on a channel nobody publishes to
+static void* readerFunc(void* arg)
+{
+    int fd = *(int*)arg;
+    char buf[64];
+    Shutdown_track(fd);
+    while (running && recv(fd, buf, sizeof(buf), 0) > 0)
+        ;
+    Shutdown_untrack(fd);
+    return NULL;
+}
+
+// a 30 s reconnect backoff or a long key check cadence
+static void* sleeperFunc(void* arg)
+{
+    (void)arg;
+    while (running)
+        Shutdown_sleep(30000);
+    return NULL;
+}
+
+// the targets' activity loop: a quiet socket plus the shutdown eventfd
+static void* pollerFunc(void* arg)
+{
+    int fd = *(int*)arg;
+    while (running)
+    {
+        struct pollfd pfds[2] = {
+            { .fd = fd, .events = POLLIN },
+            { .fd = Shutdown_fd(), .events = POLLIN }
+        };
+        poll(pfds, 2, 1000);
+    }
+    return NULL;
+}
+
+static double round_(void)
+{
+    int pairs[READERS + 1][2];
+    pthread_t readers[READERS], sleepers[SLEEPERS], poller;
+
+    for (int i = 0; i <= READERS; i++)
+        socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]);
+
+    running = true;
+    for (int i = 0; i < READERS; i++)
+        pthread_create(&readers[i], NULL, readerFunc, &pairs[i][0]);
+    for (int i = 0; i < SLEEPERS; i++)
+        pthread_create(&sleepers[i], NULL, sleeperFunc, NULL);
+    pthread_create(&poller, NULL, pollerFunc, &pairs[READERS][0]);
+
+    // let everyone block before the signal
+    const struct timespec settle = { 0, 50000000 };
+    nanosleep(&settle, NULL);
+    double start = nowMs();
+    kill(getpid(), SIGTERM);
+
+    // the main thread's cadence sleep, as in spheremon's main loop
+    while (running)
+        Shutdown_sleep(5000);
+
+    Shutdown_cutTracked();
+    for (int i = 0; i < READERS; i++)
+        pthread_join(readers[i], NULL);
+    for (int i = 0; i < SLEEPERS; i++)
+        pthread_join(sleepers[i], NULL);
+    pthread_join(poller, NULL);
+    double elapsed = nowMs() - start;
+
+    for (int i = 0; i <= READERS; i++)
+    {
+        close(pairs[i][0]);
+        close(pairs[i][1]);
+    }
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 20;
+    double boundMs = argc > 2 ? atof(argv[2]) : 100.0;
+    double worst = 0, total = 0;
+
+    signal(SIGTERM, onTerm);
+    for (int r = 0; r < rounds; r++)
+    {
+        // shutdown is one-shot per process, so each round gets its own
+        int result[2];
+        if (pipe(result))
+            return 1;
+
+        pid_t child = fork();
+        if (!child)
+        {
+            double ms = Shutdown_init(&running) ? round_() : -1;
+            _exit(write(result[1], &ms, sizeof(ms)) == sizeof(ms) ? 0 : 2);
+        }
+
+        double ms = -1;
+        int status;
+        close(result[1]);
+        if (read(result[0], &ms, sizeof(ms)) != sizeof(ms))
+            ms = -1;
+        close(result[0]);
+        waitpid(child, &status, 0);
+        if (ms < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+        {
+            fprintf(stderr, "round %d failed\n", r);
+            return 1;
+        }
+
+        total += ms;
+        worst = ms > worst ? ms : worst;
+    }
+
+    printf("%d rounds, %d readers, %d sleepers, 1 poller: SIGTERM to all joined avg %.2fms, worst %.2fms (bound %.0fms)\n",
+        rounds, READERS, SLEEPERS, total / rounds, worst, boundMs);
+    return worst <= boundMs ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+// Burst absorption of a subscriber socket with and without spheremon's
+// subscriber socket profile (sockprofile.h). A loopback "server" pushes a
+// burst of pmessage-sized frames at a subscriber that isn't reading (as
+// when the activity thread is busy) and counts how much of the burst the
+// kernel buffers take before the server would have to start queueing in its
+// own output buffer, where redis eventually disconnects slow subscribers.
+// The server's send buffer is pinned small so the count reflects the
+// subscriber's receive buffer. The baseline uses the kernel default unless
+// baseline-rcvbuf is given, e.g. to mimic the device's smaller default. The
+// profile row uses the device build's subscriber default,
+// SOCKET_SUBSCRIBER_RCVBUF (64 KiB), unless profile-rcvbuf is given; the host
+// build of spheremon leaves the buffer to autotuning instead.
+//
+// Build on any host with:
+//   cc -O2 -std=gnu11 -I../spheremon -o socket_burst socket_burst.c ../spheremon/sockprofile.c
+// Usage: socket_burst [burst-messages] [message-bytes] [profile-rcvbuf] [baseline-rcvbuf]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sockprofile.h"
+
+#define SERVER_SNDBUF 4096
+#define SETTLE_MS 100       // buffers count as full once nothing moves for this long
+
+typedef struct Result
+{
+    size_t absorbed;
+    size_t absorbedBytes;
+    int rcvBuf;
+    double drainMs;
+} Result_t;
+
+static double nowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+static bool connectPair(const SocketProfile_t* profile, int* server, int* client)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addrLen = sizeof(addr);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&addr, addrLen) || listen(listener, 1)
+        || getsockname(listener, (struct sockaddr*)&addr, &addrLen))
+        return false;
+
+    *client = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(*client, (struct sockaddr*)&addr, addrLen))
+        return false;
+    if (profile)
+        SocketProfile_apply(*client, profile);
+
+    *server = accept(listener, NULL, NULL);
+    close(listener);
+    if (*server < 0)
+        return false;
+
+    int sndBuf = SERVER_SNDBUF;
+    setsockopt(*server, SOL_SOCKET, SO_SNDBUF, &sndBuf, sizeof(sndBuf));
+    fcntl(*server, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+static bool run(const SocketProfile_t* profile, size_t burst, size_t msgBytes, Result_t* out)
+{
+    int server, client;
+    if (!connectPair(profile, &server, &client))
+    {
+        perror("loopback pair");
+        return false;
+    }
+
+    char* frame = (char*)malloc(msgBytes);
+    memset(frame, 'x', msgBytes);
+    memset(out, 0, sizeof(*out));
+
+    // the subscriber isn't reading: see how much of the burst gets buffered,
+    // giving loopback time to move data from the send to the receive queue
+    size_t partial = 0;
+    struct pollfd pfd = { .fd = server, .events = POLLOUT };
+    while (out->absorbed < burst)
+    {
+        ssize_t n = send(server, frame + partial, msgBytes - partial, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            out->absorbedBytes += (size_t)n;
+            if ((partial += (size_t)n) == msgBytes)
+            {
+                out->absorbed++;
+                partial = 0;
+            }
+        }
+        else if (errno != EAGAIN || poll(&pfd, 1, SETTLE_MS) != 1)
+            break;
+    }
+
+    socklen_t len = sizeof(out->rcvBuf);
+    getsockopt(client, SOL_SOCKET, SO_RCVBUF, &out->rcvBuf, &len);
+
+    char sink[16384];
+    double start = nowMs();
+    for (size_t got = 0; got < out->absorbedBytes; )
+    {
+        ssize_t n = recv(client, sink, sizeof(sink), 0);
+        if (n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    out->drainMs = nowMs() - start;
+
+    free(frame);
+    close(server);
+    close(client);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    size_t burst = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+    size_t msgBytes = argc > 2 ? (size_t)atol(argv[2]) : 96;
+    SocketProfile_t profiles[SocketRole_Count] = SOCKET_PROFILE_DEFAULTS;
+    SocketProfile_t profile = profiles[SocketRole_Subscriber];
+    SocketProfile_t baseline = { 0 };
+    if (argc > 3)
+        profile.rcvBuf = (uint32_t)atol(argv[3]);
+    if (argc > 4)
+        baseline.rcvBuf = (uint32_t)atol(argv[4]);
+
+    if (!burst || !msgBytes)
+    {
+        fprintf(stderr, "Usage: %s [burst-messages] [message-bytes] [profile-rcvbuf] [baseline-rcvbuf]\n\n", argv[0]);
+        exit(-1);
+    }
+
+    printf("burst of %zu x %zu-byte messages at a stalled subscriber\n", burst, msgBytes);
+    printf("%-10s %10s %12s %8s %10s %10s\n", "socket", "rcvbuf", "absorbed", "%", "bytes", "drain ms");
+
+    const char* names[] = { "baseline", "profile" };
+    const SocketProfile_t* variants[] = { baseline.rcvBuf ? &baseline : NULL, &profile };
+    for (int v = 0; v < 2; v++)
+    {
+        Result_t r;
+        if (!run(variants[v], burst, msgBytes, &r))
+            return 1;
+        printf("%-10s %10d %12zu %7.1f%% %10zu %10.2f\n", names[v], r.rcvBuf, r.absorbed,
+            100.0 * r.absorbed / burst, r.absorbedBytes, r.drainMs);
+    }
+    return 0;
+}
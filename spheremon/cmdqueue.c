@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cmdqueue.h"
+
+void CmdQueue_init(CmdQueue_t* q)
+{
+    q->head = q->count = 0;
+    q->closed = false;
+    q->rejectedFull = q->rejectedLong = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->nonEmpty, NULL);
+}
+
+CmdQueuePush_t CmdQueue_push(CmdQueue_t* q, const char* cmd)
+{
+    size_t len = strnlen(cmd, COMMAND_MAX_LEN);
+
+    pthread_mutex_lock(&q->lock);
+    CmdQueuePush_t res = CmdQueuePush_Queued;
+    if (q->closed)
+    {
+        res = CmdQueuePush_Closed;
+    }
+    else if (len >= COMMAND_MAX_LEN)
+    {
+        res = CmdQueuePush_TooLong;
+        q->rejectedLong++;
+    }
+    else if (q->count >= CMD_QUEUE_DEPTH)
+    {
+        res = CmdQueuePush_Full;
+        q->rejectedFull++;
+    }
+    else
+    {
+        CmdQueueJob_t* job = &q->jobs[(q->head + q->count++) % CMD_QUEUE_DEPTH];
+        memcpy(job->cmd, cmd, len + 1);
+        job->enqueuedUs = Command_monotonicUs();
+        pthread_cond_signal(&q->nonEmpty);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return res;
+}
+
+bool CmdQueue_pop(CmdQueue_t* q, CmdQueueJob_t* job)
+{
+    pthread_mutex_lock(&q->lock);
+    while (!q->count && !q->closed)
+        pthread_cond_wait(&q->nonEmpty, &q->lock);
+
+    bool ok = q->count > 0;
+    if (ok)
+    {
+        *job = q->jobs[q->head];
+        q->head = (q->head + 1) % CMD_QUEUE_DEPTH;
+        q->count--;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+void CmdQueue_close(CmdQueue_t* q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->nonEmpty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+size_t CmdQueue_format(CmdQueue_t* q, char* buf, size_t bufLen)
+{
+    pthread_mutex_lock(&q->lock);
+    int n = snprintf(buf, bufLen, "queue depth=%zu/%d rejected full/too-long=%llu/%llu", q->count, CMD_QUEUE_DEPTH,
+        (unsigned long long)q->rejectedFull, (unsigned long long)q->rejectedLong);
+    pthread_mutex_unlock(&q->lock);
+    return n < 0 ? 0 : (size_t)n < bufLen ? (size_t)n : bufLen - 1;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "commands.h"
+
+// Bounded FIFO between the command subscriber and the command workers. The
+// subscriber only copies the command in and goes back to draining its socket;
+// workers run handlers and write replies. A full queue rejects new commands
+// rather than stalling the subscriber, and a command too long for a job is
+// rejected outright: truncating it would publish the reply on a result
+// channel the requester isn't listening on.
+
+#define CMD_QUEUE_DEPTH 32
+#define CMD_WORKER_COUNT 2
+
+typedef struct CmdQueueJob
+{
+    char cmd[COMMAND_MAX_LEN];
+    uint64_t enqueuedUs;
+} CmdQueueJob_t;
+
+typedef struct CmdQueue
+{
+    CmdQueueJob_t jobs[CMD_QUEUE_DEPTH];
+    size_t head;
+    size_t count;
+    bool closed;
+    uint64_t rejectedFull;
+    uint64_t rejectedLong;
+    pthread_mutex_t lock;
+    pthread_cond_t nonEmpty;
+} CmdQueue_t;
+
+void CmdQueue_init(CmdQueue_t* q);
+
+typedef enum CmdQueuePush
+{
+    CmdQueuePush_Queued = 0,
+    CmdQueuePush_Full,
+    CmdQueuePush_TooLong,       // COMMAND_MAX_LEN or more
+    CmdQueuePush_Closed
+} CmdQueuePush_t;
+
+// Copies cmd in.
+CmdQueuePush_t CmdQueue_push(CmdQueue_t* q, const char* cmd);
+
+// Blocks for the next job; false once the queue is closed and drained.
+bool CmdQueue_pop(CmdQueue_t* q, CmdQueueJob_t* job);
+
+// Wakes all workers; they finish the queued jobs and then exit.
+void CmdQueue_close(CmdQueue_t* q);
+
+// "queue depth=N/N rejected full/too-long=N/N"
+size_t CmdQueue_format(CmdQueue_t* q, char* buf, size_t bufLen);
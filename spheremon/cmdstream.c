@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cmdstream.h"
+#include "commands.h"
+#include "resp.h"
+#include "reconnect.h"
+#include "shutdown.h"
+
+// longer than XREADGROUP's BLOCK, so only a dead or wedged server trips it
+#define CMDSTREAM_REPLY_TIMEOUT_SECONDS (CMDSTREAM_BLOCK_MS / 1000 + 3)
+
+static bool isBulk(const RedisObject_t* o)
+{
+    return o->type == RedisObjectType_BulkString && o->obj;
+}
+
+static RedisArray_t* asArray(const RedisObject_t* o)
+{
+    return o->type == RedisObjectType_Array && o->obj ? (RedisArray_t*)o->obj : NULL;
+}
+
+static bool expectReply(RedisConnection_t conn, RedisObjectType_t type)
+{
+    RedisObject_t reply = RedisConnection_getNextObject(conn);
+    bool ok = reply.type == type;
+    RedisObject_dealloc(reply);
+    return ok;
+}
+
+static bool createGroup(RedisConnection_t conn, const char* group)
+{
+    const char* argv[] = { "XGROUP", "CREATE", CMDSTREAM_KEY, group, "$", "MKSTREAM" };
+    if (!Resp_sendCommand(conn, 6, argv, NULL))
+        return false;
+
+    // an existing group answers -BUSYGROUP, which is fine; any other error isn't
+    RedisObject_t reply = RedisConnection_getNextObject(conn);
+    bool ok = reply.type == RedisObjectType_SimpleString;
+    if (reply.type == RedisObjectType_Error && reply.obj)
+    {
+        const char* err = (const char*)reply.obj;
+        ok = !strncmp(err + (*err == '-'), "BUSYGROUP", strlen("BUSYGROUP"));
+        if (!ok)
+            fprintf(stderr, "XGROUP CREATE %s failed: %s\n", group, err);
+    }
+    RedisObject_dealloc(reply);
+    return ok;
+}
+
+// Runs one entry's command and writes its reply; returns false on a connection error.
+static bool handleEntry(RedisConnection_t conn, const CmdStreamArgs_t* sArgs, const char* entryId, RedisArray_t* fields)
+{
+    const char *cmd = NULL, *reqId = entryId, *target = NULL, *replyTo = NULL;
+    for (size_t i = 0; i + 1 < fields->count; i += 2)
+    {
+        if (!isBulk(&fields->objects[i]) || !isBulk(&fields->objects[i + 1]))
+            continue;
+
+        const char* name = (const char*)fields->objects[i].obj;
+        const char* value = (const char*)fields->objects[i + 1].obj;
+        if (!strcmp(name, "cmd"))
+            cmd = value;
+        else if (!strcmp(name, "id"))
+            reqId = value;
+        else if (!strcmp(name, "target"))
+            target = value;
+        else if (!strcmp(name, "reply-to"))
+            replyTo = value;
+    }
+
+    if (replyTo && strncmp(replyTo, CMDSTREAM_REPLY_PREFIX, strlen(CMDSTREAM_REPLY_PREFIX)))
+    {
+        fprintf(stderr, "command stream: reply-to '%s' outside " CMDSTREAM_REPLY_PREFIX "*, using the default\n", replyTo);
+        replyTo = NULL;
+    }
+
+    char reply[COMMAND_REPLY_SIZE] = { 0 };
+    CommandResult_t res = CommandResult_NoReply;
+    if (cmd && (!target || !strcmp(target, sArgs->deviceId)))
+    {
+        res = Command_dispatch(cmd, reply, sizeof(reply));
+        if (res == CommandResult_Unknown)
+        {
+            snprintf(reply, sizeof(reply), "unknown command");
+            res = CommandResult_BadArgs;
+        }
+    }
+
+    char ttl[16];
+    snprintf(ttl, sizeof(ttl), "%d", CMDSTREAM_REPLY_TTL_SECONDS);
+
+    // the requester picks reply-to and request-id, so size everything from them
+    // rather than truncating the key and replying where nobody listens
+    size_t keyLen = replyTo ? strlen(replyTo)
+        : strlen(CMDSTREAM_REPLY_PREFIX) + strlen(reqId) + 1 + strlen(sArgs->deviceId);
+    size_t need = 512 + 3 * keyLen + strlen(reply) + strlen(sArgs->deviceId) + strlen(entryId);
+    char* replyKey = (char*)malloc(keyLen + 1);
+    char* buf = (char*)malloc(need);
+    if (!replyKey || !buf)
+    {
+        free(replyKey);
+        free(buf);
+        return false;
+    }
+    if (replyTo)
+        memcpy(replyKey, replyTo, keyLen + 1);
+    else
+        snprintf(replyKey, keyLen + 1, CMDSTREAM_REPLY_PREFIX "%s:%s", reqId, sArgs->deviceId);
+
+    bool sendReply = res == CommandResult_Reply || res == CommandResult_BadArgs;
+    const char* pushArgs[] = { "LPUSH", replyKey, reply };
+    const char* expireArgs[] = { "EXPIRE", replyKey, ttl };
+    const char* ackArgs[] = { "XACK", CMDSTREAM_KEY, sArgs->deviceId, entryId };
+
+    // reply and ack go out together; the ack is last so a crash in between
+    // re-delivers the request rather than losing its reply
+    size_t len = 0, w = 1;
+    if (sendReply)
+    {
+        len += (w = Resp_encodeCommand(buf + len, need - len, 3, pushArgs, NULL));
+        if (w)
+            len += (w = Resp_encodeCommand(buf + len, need - len, 3, expireArgs, NULL));
+    }
+    if (w)
+        w = Resp_encodeCommand(buf + len, need - len, 4, ackArgs, NULL);
+    len += w;
+
+    // a partial pipeline would leave us waiting on replies that never come
+    bool sent = w && Resp_sendRaw(conn, buf, len);
+    free(replyKey);
+    free(buf);
+    if (!sent)
+        return false;
+
+    bool ok = true;
+    if (sendReply)
+        ok = expectReply(conn, RedisObjectType_Integer) & expectReply(conn, RedisObjectType_Integer);
+    ok &= expectReply(conn, RedisObjectType_Integer);
+
+    if (sendReply)
+    {
+        printf("Command '%s' respone: '%s' (stream %s)\n", cmd, reply, reqId);
+        fflush(stdout);
+    }
+    return ok;
+}
+
+// Reads one batch; "0" re-reads this consumer's pending entries, ">" new ones.
+// Returns the number of entries handled, or -1 on a connection error.
+static int readBatch(RedisConnection_t conn, const CmdStreamArgs_t* sArgs, const char* fromId)
+{
+    char block[16], count[16];
+    snprintf(block, sizeof(block), "%d", CMDSTREAM_BLOCK_MS);
+    snprintf(count, sizeof(count), "%d", CMDSTREAM_BATCH);
+    const char* argv[] = { "XREADGROUP", "GROUP", sArgs->deviceId, sArgs->deviceId,
+        "COUNT", count, "BLOCK", block, "STREAMS", CMDSTREAM_KEY, fromId };
+
+    if (!Resp_sendCommand(conn, 11, argv, NULL))
+        return -1;
+
+    RedisObject_t reply = RedisConnection_getNextObject(conn);
+    if (reply.type == RedisObjectType_Error || reply.type == RedisObjectType_Invalid)
+    {
+        RedisObject_dealloc(reply);
+        return -1;
+    }
+
+    // [[stream, [[id, [field, value, ...]], ...]]], or nil on timeout
+    int handled = 0;
+    RedisArray_t* streams = asArray(&reply);
+    RedisArray_t* stream = streams && streams->count ? asArray(&streams->objects[0]) : NULL;
+    RedisArray_t* entries = stream && stream->count == 2 ? asArray(&stream->objects[1]) : NULL;
+
+    for (size_t i = 0; entries && i < entries->count && handled >= 0; i++)
+    {
+        RedisArray_t* entry = asArray(&entries->objects[i]);
+        if (!entry || entry->count != 2 || !isBulk(&entry->objects[0]))
+            continue;
+
+        // pending entries that were since deleted come back with nil fields
+        RedisArray_t* fields = asArray(&entry->objects[1]);
+        RedisArray_t none = { 0 };
+        if (!handleEntry(conn, sArgs, (const char*)entry->objects[0].obj, fields ? fields : &none))
+            handled = -1;
+        else
+            handled++;
+    }
+
+    RedisObject_dealloc(reply);
+    return handled;
+}
+
+static void closeConn(const CmdStreamArgs_t* sArgs, RedisConnection_t conn)
+{
+    if (sArgs->disconnect)
+        sArgs->disconnect(sArgs->ctx, conn);
+    else
+        close(conn);
+}
+
+void* CmdStream_threadFunc(void* arg)
+{
+    CmdStreamArgs_t* sArgs = (CmdStreamArgs_t*)arg;
+    RedisConnection_t conn = -1;
+    bool drainPending = true;
+
+    while (*sArgs->running)
+    {
+        if (conn < 1)
+        {
+            conn = Reconnect_until(ReconnectLink_CommandStream, sArgs->connect, sArgs->ctx, sArgs->running);
+            if (conn > 0 && !createGroup(conn, sArgs->deviceId))
+            {
+                closeConn(sArgs, conn);
+                conn = -1;
+                Shutdown_sleep(1000);
+                continue;
+            }
+            if (conn < 1)
+                break;
+
+            // XREADGROUP blocks for up to CMDSTREAM_BLOCK_MS
+            Resp_setReplyTimeout(conn, CMDSTREAM_REPLY_TIMEOUT_SECONDS);
+            Shutdown_track(conn);
+
+            if (sArgs->onConnected)
+                sArgs->onConnected(sArgs->ctx);
+            drainPending = true;
+        }
+
+        int n = readBatch(conn, sArgs, drainPending ? "0" : ">");
+        if (n < 0)
+        {
+            fprintf(stderr, "command stream connection lost, reconnecting\n");
+            Shutdown_untrack(conn);
+            closeConn(sArgs, conn);
+            conn = -1;
+            Reconnect_lost(ReconnectLink_CommandStream);
+        }
+        else if (drainPending && !n)
+        {
+            drainPending = false;
+        }
+    }
+
+    if (conn > 0)
+    {
+        Shutdown_untrack(conn);
+        closeConn(sArgs, conn);
+    }
+    return NULL;
+}
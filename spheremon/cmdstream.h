@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <signal.h>
+
+#include <yarl.h>
+
+// Request/response command transport over a redis stream. Requesters XADD
+//   spheremon:commands MAXLEN ~ <n> * cmd <command> [id <request-id>] [target <device>] [reply-to <key>]
+// Each device reads the stream through its own consumer group (named after
+// the device), so every device sees every request exactly once and anything
+// delivered but not yet acknowledged is re-read after a reconnect. The reply
+// is LPUSHed to reply-to, defaulting to spheremon:reply:<request-id>:<device>
+// (request-id defaults to the entry ID), given an expiry, and only then is
+// the entry XACKed. Requests whose target names another device are acked
+// without a reply. reply-to must lie under CMDSTREAM_REPLY_PREFIX; any other
+// key is ignored in favour of the default, so a request can't have a device
+// write into arbitrary keys.
+//
+// XACK only clears the group's pending list, and no device trims the stream,
+// since none knows how far the other groups have got. The MAXLEN ~ on every
+// XADD is what bounds it: pick n so a request outlives the longest outage a
+// device should still catch up from. Older ones are trimmed unseen, and a
+// pending one trimmed before its ack is acked without a reply.
+
+#define CMDSTREAM_KEY               "spheremon:commands"
+#define CMDSTREAM_REPLY_PREFIX      "spheremon:reply:"
+#define CMDSTREAM_REPLY_TTL_SECONDS 300
+#define CMDSTREAM_BLOCK_MS          2000
+#define CMDSTREAM_BATCH             16
+
+typedef struct CmdStreamArgs
+{
+    RedisConnection_t (*connect)(void* ctx);
+    void (*disconnect)(void* ctx, RedisConnection_t conn);  // optional; closes in place of close()
+    void* ctx;
+    const char* deviceId;
+    volatile sig_atomic_t* running;
+    void (*onConnected)(void* ctx); // optional; after each (re)connect, once the group exists
+} CmdStreamArgs_t;
+
+// Thread entry point; arg is a CmdStreamArgs_t*. Reconnects on its own and
+// returns once *running is cleared.
+void* CmdStream_threadFunc(void* arg);
@@ -0,0 +1,12 @@
+#pragma once
+
+// Generated by tools/gen_commandhash.py from commands.def; do not edit.
+
+#include <stdint.h>
+
+#define COMMAND_HASH_SEED 7u
+#define COMMAND_HASH_MASK 63u
+#define COMMAND_HASH_COUNT 24
+#define COMMAND_HASH_EMPTY 255
+
+static const uint8_t CommandHashSlots[64] = { 255, 255, 6, 255, 255, 255, 255, 255, 1, 15, 22, 255, 255, 255, 2, 255, 255, 7, 255, 23, 8, 4, 255, 255, 255, 255, 255, 255, 255, 255, 12, 255, 16, 18, 255, 255, 255, 255, 255, 255, 9, 5, 255, 21, 19, 17, 255, 255, 255, 20, 255, 14, 255, 255, 13, 255, 11, 3, 255, 0, 255, 255, 10, 255 };
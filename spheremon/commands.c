@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+
+#include "commands.h"
+#include "commandhash.h"
+
+const Command_t Commands[] = {
+#define COMMAND(name, handler, schema, help) { name, handler, schema, help },
+#include "commands.def"
+#undef COMMAND
+};
+
+const size_t CommandCount = sizeof(Commands) / sizeof(Commands[0]);
+
+static CommandStats_t stats[sizeof(Commands) / sizeof(Commands[0])];
+
+uint64_t Command_monotonicUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static void recordMax(_Atomic uint64_t* max, uint64_t v)
+{
+    uint64_t cur = atomic_load_explicit(max, memory_order_relaxed);
+    while (v > cur && !atomic_compare_exchange_weak_explicit(max, &cur, v, memory_order_relaxed, memory_order_relaxed));
+}
+
+static void recordTiming(const Command_t* cmd, uint64_t queuedUs, uint64_t execUs)
+{
+    CommandStats_t* s = &stats[cmd - Commands];
+    atomic_fetch_add_explicit(&s->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->queueUsTotal, queuedUs, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->execUsTotal, execUs, memory_order_relaxed);
+    recordMax(&s->queueUsMax, queuedUs);
+    recordMax(&s->execUsMax, execUs);
+}
+
+uint32_t Command_hash(uint32_t seed, const char* name, size_t len)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+const Command_t* Command_lookup(const char* name, size_t len)
+{
+    uint8_t idx = CommandHashSlots[Command_hash(COMMAND_HASH_SEED, name, len) & COMMAND_HASH_MASK];
+    if (idx == COMMAND_HASH_EMPTY)
+        return NULL;
+
+    const Command_t* cmd = &Commands[idx];
+    return strlen(cmd->name) == len && !memcmp(cmd->name, name, len) ? cmd : NULL;
+}
+
+static bool parseArgs(const Command_t* cmd, CommandArgs_t* args)
+{
+    size_t required = 0, total = strlen(cmd->schema);
+    while (required < total && islower((unsigned char)cmd->schema[required]))
+        required++;
+
+    size_t given = (size_t)args->argc - 1;
+    if (given < required || given > total)
+        return false;
+
+    for (size_t i = 0; i < given; i++)
+    {
+        if (tolower((unsigned char)cmd->schema[i]) == 'u')
+        {
+            // handlers take 'u' arguments as uint32_t, so anything wider is
+            // rejected here rather than silently truncated
+            char* end;
+            const char* arg = args->argv[i + 1];
+            errno = 0;
+            unsigned long long v = strtoull(arg, &end, 10);
+            if (!isdigit((unsigned char)*arg) || *end || errno == ERANGE || v > UINT32_MAX)
+                return false;
+            args->num[i + 1] = (unsigned long)v;
+        }
+    }
+    return true;
+}
+
+CommandResult_t Command_dispatch(const char* cmdStr, char* reply, size_t replyLen)
+{
+    return Command_dispatchQueued(cmdStr, 0, reply, replyLen);
+}
+
+CommandResult_t Command_dispatchQueued(const char* cmdStr, uint64_t queuedUs, char* reply, size_t replyLen)
+{
+    char buf[COMMAND_MAX_LEN];
+    CommandArgs_t args = { 0 };
+    char* save = NULL;
+
+    // a truncated command could still parse, as something the sender didn't ask for
+    if (strnlen(cmdStr, sizeof(buf)) >= sizeof(buf))
+    {
+        snprintf(reply, replyLen, "command too long (max %d)", COMMAND_MAX_LEN - 1);
+        return CommandResult_BadArgs;
+    }
+
+    snprintf(buf, sizeof(buf), "%s", cmdStr);
+    for (char* tok = strtok_r(buf, " \t\r\n", &save); tok && args.argc < COMMAND_MAX_ARGS;
+        tok = strtok_r(NULL, " \t\r\n", &save))
+    {
+        args.argv[args.argc++] = tok;
+    }
+
+    const Command_t* cmd = args.argc ? Command_lookup(args.argv[0], strlen(args.argv[0])) : NULL;
+    if (!cmd)
+        return CommandResult_Unknown;
+
+    if (!parseArgs(cmd, &args))
+    {
+        snprintf(reply, replyLen, "usage: %s", cmd->help);
+        return CommandResult_BadArgs;
+    }
+
+    uint64_t start = Command_monotonicUs();
+    bool hasReply = cmd->handler(&args, reply, replyLen);
+    recordTiming(cmd, queuedUs, Command_monotonicUs() - start);
+    return hasReply ? CommandResult_Reply : CommandResult_NoReply;
+}
+
+bool Command_verifyTable(void)
+{
+    if (CommandCount != COMMAND_HASH_COUNT)
+        return false;
+
+    for (size_t i = 0; i < CommandCount; i++)
+        if (Command_lookup(Commands[i].name, strlen(Commands[i].name)) != &Commands[i])
+            return false;
+    return true;
+}
+
+bool cmdHelp(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    if (args->argc > 1)
+    {
+        const Command_t* cmd = Command_lookup(args->argv[1], strlen(args->argv[1]));
+        snprintf(reply, replyLen, "%s", cmd ? cmd->help : "unknown command");
+        return true;
+    }
+
+    size_t off = 0;
+    reply[0] = '\0';
+    for (size_t i = 0; i < CommandCount && off < replyLen; i++)
+        off += (size_t)snprintf(reply + off, replyLen - off, "%s%s", i ? " " : "", Commands[i].name);
+    return true;
+}
+
+static int formatStats(size_t i, char* out, size_t outLen)
+{
+    CommandStats_t* s = &stats[i];
+    uint64_t n = atomic_load_explicit(&s->count, memory_order_relaxed);
+    return snprintf(out, outLen, "%s n=%llu queue=%llu/%lluus exec=%llu/%lluus", Commands[i].name,
+        (unsigned long long)n,
+        (unsigned long long)(n ? atomic_load_explicit(&s->queueUsTotal, memory_order_relaxed) / n : 0),
+        (unsigned long long)atomic_load_explicit(&s->queueUsMax, memory_order_relaxed),
+        (unsigned long long)(n ? atomic_load_explicit(&s->execUsTotal, memory_order_relaxed) / n : 0),
+        (unsigned long long)atomic_load_explicit(&s->execUsMax, memory_order_relaxed));
+}
+
+size_t Command_formatStats(const char* name, char* out, size_t outLen)
+{
+    int n;
+    if (name)
+    {
+        const Command_t* cmd = Command_lookup(name, strlen(name));
+        n = cmd ? formatStats((size_t)(cmd - Commands), out, outLen) : snprintf(out, outLen, "unknown command");
+        return n < 0 ? 0 : (size_t)n < outLen ? (size_t)n : outLen - 1;
+    }
+
+    size_t off = 0;
+    out[0] = '\0';
+    for (size_t i = 0; i < CommandCount && off < outLen; i++)
+    {
+        if (i)
+            off += (size_t)snprintf(out + off, outLen - off, "; ");
+        if (off < outLen)
+            off += (size_t)formatStats(i, out + off, outLen - off);
+    }
+    return off < outLen ? off : outLen - 1;
+}
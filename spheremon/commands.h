@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Table-driven command registry (see commands.def). Names are matched exactly
+// through a perfect hash generated at build time into commandhash.h.
+
+#define COMMAND_MAX_ARGS 8
+#define COMMAND_MAX_LEN 256
+// reply buffer each transport dispatches into
+#define COMMAND_REPLY_SIZE 1536
+
+typedef struct CommandArgs
+{
+    int argc;
+    const char* argv[COMMAND_MAX_ARGS];      // argv[0] is the command name
+    unsigned long num[COMMAND_MAX_ARGS];     // parsed value of each 'u' argument, 0..UINT32_MAX
+} CommandArgs_t;
+
+// Fills reply and returns true if a reply should be sent.
+typedef bool (*CommandHandler_t)(const CommandArgs_t* args, char* reply, size_t replyLen);
+
+typedef struct Command
+{
+    const char* name;
+    CommandHandler_t handler;
+    const char* schema;
+    const char* help;
+} Command_t;
+
+// Per-command latency, split into time spent queued before a worker picked
+// the command up and time spent in its handler.
+typedef struct CommandStats
+{
+    _Atomic uint64_t count;
+    _Atomic uint64_t queueUsTotal;
+    _Atomic uint64_t queueUsMax;
+    _Atomic uint64_t execUsTotal;
+    _Atomic uint64_t execUsMax;
+} CommandStats_t;
+
+typedef enum CommandResult
+{
+    CommandResult_Reply = 0,
+    CommandResult_NoReply,
+    CommandResult_Unknown,
+    CommandResult_BadArgs       // reply holds the command's usage
+} CommandResult_t;
+
+#define COMMAND(name, handler, schema, help) \
+    bool handler(const CommandArgs_t* args, char* reply, size_t replyLen);
+#include "commands.def"
+#undef COMMAND
+
+extern const Command_t Commands[];
+extern const size_t CommandCount;
+
+// FNV-1a over name, seeded; must match tools/gen_commandhash.py.
+uint32_t Command_hash(uint32_t seed, const char* name, size_t len);
+
+const Command_t* Command_lookup(const char* name, size_t len);
+
+// Tokenizes cmdStr, looks the command up, validates its arguments against the
+// schema and runs the handler. Commands of COMMAND_MAX_LEN or more are refused
+// with CommandResult_BadArgs.
+CommandResult_t Command_dispatch(const char* cmdStr, char* reply, size_t replyLen);
+
+// As Command_dispatch, recording queuedUs and the handler's run time in the
+// command's stats.
+CommandResult_t Command_dispatchQueued(const char* cmdStr, uint64_t queuedUs, char* reply, size_t replyLen);
+
+uint64_t Command_monotonicUs(void);
+
+// Stats for the named command, or every command when name is NULL, as
+// "name n=N queue=avg/maxus exec=avg/maxus[; ...]". Returns the length written.
+size_t Command_formatStats(const char* name, char* out, size_t outLen);
+
+// Checks commandhash.h against commands.def; false means it needs regenerating.
+bool Command_verifyTable(void);
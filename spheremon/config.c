@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "config.h"
+#include "counters.h"
+
+typedef struct ReaderSlot
+{
+    // 0 when outside a read section, else the epoch at entry
+    _Alignas(COUNTER_CACHE_LINE) _Atomic uint64_t epoch;
+} ReaderSlot_t;
+
+static _Atomic(Config_t*) current;
+static _Atomic uint64_t generation;
+static _Atomic uint64_t globalEpoch = 1;
+static ReaderSlot_t readers[ConfigReader_Count];
+static pthread_mutex_t writerLock = PTHREAD_MUTEX_INITIALIZER;
+
+void Config_init(const Config_t* initial)
+{
+    Config_t* c = (Config_t*)malloc(sizeof(Config_t));
+    *c = *initial;
+    atomic_store(&generation, c->generation);
+    atomic_store(&current, c);
+}
+
+const Config_t* Config_enter(ConfigReader_t reader)
+{
+    // seq_cst: the slot must be visible before we read the pointer
+    atomic_store(&readers[reader].epoch, atomic_load(&globalEpoch));
+    return atomic_load(&current);
+}
+
+void Config_exit(ConfigReader_t reader)
+{
+    atomic_store_explicit(&readers[reader].epoch, 0, memory_order_release);
+}
+
+uint64_t Config_generation(void)
+{
+    return atomic_load_explicit(&generation, memory_order_acquire);
+}
+
+static void waitForReaders(uint64_t epoch)
+{
+    for (int r = 0; r < ConfigReader_Count; r++)
+    {
+        uint64_t e;
+        while ((e = atomic_load(&readers[r].epoch)) && e < epoch)
+            sched_yield();
+    }
+}
+
+bool Config_update(ConfigMutator_t mutate, const void* ctx)
+{
+    pthread_mutex_lock(&writerLock);
+    Config_t* old = atomic_load(&current);
+    Config_t* next = (Config_t*)malloc(sizeof(Config_t));
+    bool ok = next != NULL;
+
+    if (ok)
+    {
+        *next = *old;
+        ok = mutate(next, ctx);
+    }
+
+    if (ok)
+    {
+        next->generation = old->generation + 1;
+        atomic_store(&current, next);
+        atomic_store_explicit(&generation, next->generation, memory_order_release);
+
+        // anyone who entered before the bump may still hold old
+        uint64_t epoch = atomic_fetch_add(&globalEpoch, 1) + 1;
+        waitForReaders(epoch);
+        free(old);
+    }
+    else
+    {
+        free(next);
+    }
+
+    pthread_mutex_unlock(&writerLock);
+    return ok;
+}
+
+void Config_copy(Config_t* out)
+{
+    pthread_mutex_lock(&writerLock);
+    *out = *atomic_load(&current);
+    pthread_mutex_unlock(&writerLock);
+}
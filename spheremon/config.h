@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sockprofile.h"
+
+// Runtime configuration, published as immutable snapshots in the style of
+// RCU: readers bracket their use of a snapshot with Config_enter/Config_exit
+// (two atomic stores, no lock) and writers copy, modify and swap the whole
+// snapshot, freeing the old one once no reader can still see it.
+
+#define CONFIG_MAX_PATTERNS 8
+#define CONFIG_PATTERN_LEN 64
+
+typedef struct Config
+{
+    uint64_t generation;
+    uint64_t keysGeneration;        // bumped whenever tracked keys must be re-queried
+    uint32_t keyCheckCadenceSeconds;
+    uint32_t watchIntervalSeconds;
+    char subscribePattern[CONFIG_PATTERN_LEN];
+    size_t keyPatternCount;
+    char keyPatterns[CONFIG_MAX_PATTERNS][CONFIG_PATTERN_LEN];
+    SocketProfile_t socketProfiles[SocketRole_Count];   // applied on each new connection
+} Config_t;
+
+// One slot per thread that reads snapshots on a hot path.
+typedef enum ConfigReader
+{
+    ConfigReader_Main = 0,
+    ConfigReader_Activity,
+    ConfigReader_Watch,
+    ConfigReader_Count
+} ConfigReader_t;
+
+// Mutates next in place; returning false abandons the update. ctx is passed through.
+typedef bool (*ConfigMutator_t)(Config_t* next, const void* ctx);
+
+void Config_init(const Config_t* initial);
+
+// The snapshot stays valid until the matching Config_exit; don't block in between.
+const Config_t* Config_enter(ConfigReader_t reader);
+void Config_exit(ConfigReader_t reader);
+
+// Cheap check for "has anything changed since I last looked".
+uint64_t Config_generation(void);
+
+// Copy-modify-swap under the writer lock; waits out readers of the old snapshot.
+bool Config_update(ConfigMutator_t mutate, const void* ctx);
+
+// Copies the current snapshot, for cold paths without a reader slot.
+void Config_copy(Config_t* out);
@@ -0,0 +1,471 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "connect.h"
+
+typedef struct ConnectAddr
+{
+    struct sockaddr_storage addr;
+    socklen_t len;
+} ConnectAddr_t;
+
+typedef struct CacheEntry
+{
+    char host[256];
+    char port[16];
+    ConnectAddr_t addrs[CONNECT_MAX_CANDIDATES];   // already interleaved
+    size_t count;
+    uint64_t resolvedUs;
+    uint64_t lastUsedUs;
+    bool resolving;
+} CacheEntry_t;
+
+typedef struct Attempt
+{
+    int fd;
+    uint64_t startUs;
+    const ConnectAddr_t* ca;
+} Attempt_t;
+
+typedef enum AttemptResult
+{
+    AttemptResult_Success,
+    AttemptResult_Failure,
+    AttemptResult_Timeout
+} AttemptResult_t;
+
+static ConnectAddrStats_t stats[CONNECT_STATS_SLOTS];
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static CacheEntry_t cache[CONNECT_CACHE_SLOTS];
+static ConnectCacheStats_t cacheStats;
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cacheResolved = PTHREAD_COND_INITIALIZER;
+
+static uint64_t nowUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static void formatAddr(const ConnectAddr_t* ca, char* out, size_t outLen)
+{
+    const void* addr = ca->addr.ss_family == AF_INET
+        ? (const void*)&((const struct sockaddr_in*)&ca->addr)->sin_addr
+        : (const void*)&((const struct sockaddr_in6*)&ca->addr)->sin6_addr;
+    if (!inet_ntop(ca->addr.ss_family, addr, out, outLen))
+        snprintf(out, outLen, "?");
+}
+
+static void record(const ConnectAddr_t* ca, AttemptResult_t result, uint64_t elapsedUs)
+{
+    char addr[INET6_ADDRSTRLEN];
+    formatAddr(ca, addr, sizeof(addr));
+
+    pthread_mutex_lock(&statsLock);
+    // reuse this address's slot, else evict the least recently tried one
+    ConnectAddrStats_t* slot = &stats[0];
+    for (size_t i = 0; i < CONNECT_STATS_SLOTS; i++)
+    {
+        if (!strcmp(stats[i].addr, addr))
+        {
+            slot = &stats[i];
+            break;
+        }
+        if (stats[i].lastAttemptUs < slot->lastAttemptUs)
+            slot = &stats[i];
+    }
+
+    if (strcmp(slot->addr, addr))
+    {
+        memset(slot, 0, sizeof(*slot));
+        strcpy(slot->addr, addr);
+    }
+
+    slot->lastAttemptUs = nowUs();
+    switch (result)
+    {
+    case AttemptResult_Success:
+        slot->successes++;
+        slot->lastUs = (uint32_t)elapsedUs;
+        slot->totalUs += elapsedUs;
+        if (slot->lastUs > slot->maxUs)
+            slot->maxUs = slot->lastUs;
+        break;
+    case AttemptResult_Failure:
+        slot->failures++;
+        break;
+    case AttemptResult_Timeout:
+        slot->timeouts++;
+        break;
+    }
+    pthread_mutex_unlock(&statsLock);
+}
+
+// getaddrinfo order within each family, alternating families, IPv6 first
+static size_t interleave(const struct addrinfo* list, ConnectAddr_t* out)
+{
+    const struct addrinfo* v6[CONNECT_MAX_CANDIDATES];
+    const struct addrinfo* v4[CONNECT_MAX_CANDIDATES];
+    size_t n6 = 0, n4 = 0;
+
+    for (const struct addrinfo* p = list; p; p = p->ai_next)
+    {
+        if (p->ai_family == AF_INET6 && n6 < CONNECT_MAX_CANDIDATES)
+            v6[n6++] = p;
+        else if (p->ai_family == AF_INET && n4 < CONNECT_MAX_CANDIDATES)
+            v4[n4++] = p;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; n < CONNECT_MAX_CANDIDATES && (i < n6 || i < n4); i++)
+    {
+        const struct addrinfo* pick[2] = { i < n6 ? v6[i] : NULL, i < n4 ? v4[i] : NULL };
+        for (int f = 0; f < 2 && n < CONNECT_MAX_CANDIDATES; f++)
+        {
+            if (!pick[f])
+                continue;
+            memcpy(&out[n].addr, pick[f]->ai_addr, pick[f]->ai_addrlen);
+            out[n++].len = pick[f]->ai_addrlen;
+        }
+    }
+    return n;
+}
+
+static CacheEntry_t* cacheFind(const char* host, const char* port)
+{
+    CacheEntry_t* victim = &cache[0];
+    for (size_t i = 0; i < CONNECT_CACHE_SLOTS; i++)
+    {
+        if (!strcmp(cache[i].host, host) && !strcmp(cache[i].port, port))
+            return &cache[i];
+        if (cache[i].lastUsedUs < victim->lastUsedUs)
+            victim = &cache[i];
+    }
+
+    if (strlen(host) >= sizeof(victim->host) || strlen(port) >= sizeof(victim->port) || victim->resolving)
+        return NULL;
+
+    memset(victim, 0, sizeof(*victim));
+    strcpy(victim->host, host);
+    strcpy(victim->port, port);
+    return victim;
+}
+
+// copies host's addresses into out, resolving if the cached ones are older
+// than maxAgeUs; returns the count, 0 if nothing could be resolved
+static size_t resolve(const char* host, const char* port, uint64_t maxAgeUs, ConnectAddr_t* out)
+{
+    ConnectAddr_t fresh[CONNECT_MAX_CANDIDATES];
+    memset(fresh, 0, sizeof(fresh));    // compared with memcmp, padding included
+    uint64_t now = nowUs();
+
+    pthread_mutex_lock(&cacheLock);
+    CacheEntry_t* entry = cacheFind(host, port);
+    bool expired = !entry || !entry->count || now - entry->resolvedUs >= maxAgeUs;
+    if (entry && entry->count && (!expired || entry->resolving))
+    {
+        // fresh, or someone else is already refreshing it
+        if (expired)
+            cacheStats.staleServed++;
+        else
+            cacheStats.hits++;
+        entry->lastUsedUs = now;
+        size_t count = entry->count;
+        memcpy(out, entry->addrs, count * sizeof(ConnectAddr_t));
+        pthread_mutex_unlock(&cacheLock);
+        return count;
+    }
+    if (entry && entry->resolving)
+    {
+        // nothing cached to fall back on: share the lookup already in flight
+        // rather than pile another getaddrinfo onto a struggling resolver
+        cacheStats.coalesced++;
+        while (entry->resolving)
+            pthread_cond_wait(&cacheResolved, &cacheLock);
+        size_t count = !strcmp(entry->host, host) && !strcmp(entry->port, port) ? entry->count : 0;
+        memcpy(out, entry->addrs, count * sizeof(ConnectAddr_t));
+        pthread_mutex_unlock(&cacheLock);
+        return count;
+    }
+    if (entry)
+        entry->resolving = true;
+    cacheStats.resolves++;
+    pthread_mutex_unlock(&cacheLock);
+
+    struct addrinfo hints, *servinfo;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    size_t count = 0;
+    int rv = getaddrinfo(host, port, &hints, &servinfo);
+    if (rv)
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rv));
+    else
+    {
+        count = interleave(servinfo, fresh);
+        freeaddrinfo(servinfo);
+    }
+
+    pthread_mutex_lock(&cacheLock);
+    if (!count)
+        cacheStats.resolveFailures++;
+    if (entry)
+    {
+        entry->resolving = false;
+        entry->lastUsedUs = nowUs();
+        if (count)
+        {
+            memcpy(entry->addrs, fresh, count * sizeof(ConnectAddr_t));
+            entry->count = count;
+            entry->resolvedUs = entry->lastUsedUs;
+        }
+        else if (entry->count)
+        {
+            // a failed lookup shouldn't take down a working address
+            cacheStats.staleServed++;
+            count = entry->count;
+            memcpy(fresh, entry->addrs, count * sizeof(ConnectAddr_t));
+        }
+        pthread_cond_broadcast(&cacheResolved);
+    }
+    pthread_mutex_unlock(&cacheLock);
+
+    memcpy(out, fresh, count * sizeof(ConnectAddr_t));
+    return count;
+}
+
+// starts a non-blocking connect; returns the fd, or -1 if it failed outright
+static int startAttempt(const ConnectAddr_t* ca, bool* connected)
+{
+    int fd = socket(ca->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    *connected = connect(fd, (const struct sockaddr*)&ca->addr, ca->len) == 0;
+    if (!*connected && errno != EINPROGRESS)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int finish(int fd)
+{
+    // yarl expects blocking reads
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    return fd;
+}
+
+// returns the winning (still non-blocking) fd, or -1
+static int race(const ConnectAddr_t* candidates, size_t candidateCount)
+{
+    Attempt_t active[CONNECT_MAX_CANDIDATES];
+    size_t activeCount = 0, next = 0;
+    uint64_t nextStartUs = nowUs();
+    int winner = -1;
+
+    while (winner == -1 && (activeCount || next < candidateCount))
+    {
+        uint64_t now = nowUs();
+
+        if (next < candidateCount && now >= nextStartUs)
+        {
+            const ConnectAddr_t* ca = &candidates[next++];
+            bool connected;
+            int fd = startAttempt(ca, &connected);
+            if (fd != -1 && connected)
+            {
+                record(ca, AttemptResult_Success, nowUs() - now);
+                winner = fd;
+                break;
+            }
+
+            if (fd == -1)
+            {
+                record(ca, AttemptResult_Failure, 0);
+                nextStartUs = now;
+                continue;
+            }
+
+            active[activeCount++] = (Attempt_t){ fd, now, ca };
+            nextStartUs = now + CONNECT_ATTEMPT_DELAY_MS * 1000;
+        }
+
+        // time out stale attempts; a slot freed this way lets the next start now
+        for (size_t i = 0; i < activeCount; )
+        {
+            if (now - active[i].startUs >= CONNECT_ATTEMPT_TIMEOUT_MS * 1000ULL)
+            {
+                record(active[i].ca, AttemptResult_Timeout, now - active[i].startUs);
+                close(active[i].fd);
+                active[i] = active[--activeCount];
+                nextStartUs = now;
+            }
+            else
+                i++;
+        }
+
+        if (!activeCount)
+            continue;
+
+        // sleep until an attempt finishes, times out, or the next is due
+        uint64_t wakeUs = now + CONNECT_ATTEMPT_TIMEOUT_MS * 1000ULL;
+        for (size_t i = 0; i < activeCount; i++)
+            if (active[i].startUs + CONNECT_ATTEMPT_TIMEOUT_MS * 1000ULL < wakeUs)
+                wakeUs = active[i].startUs + CONNECT_ATTEMPT_TIMEOUT_MS * 1000ULL;
+        if (next < candidateCount && nextStartUs < wakeUs)
+            wakeUs = nextStartUs;
+
+        struct pollfd pfds[CONNECT_MAX_CANDIDATES];
+        for (size_t i = 0; i < activeCount; i++)
+            pfds[i] = (struct pollfd){ .fd = active[i].fd, .events = POLLOUT };
+
+        int ready = poll(pfds, activeCount, wakeUs > now ? (int)((wakeUs - now + 999) / 1000) : 0);
+        if (ready <= 0)
+            continue;
+
+        now = nowUs();
+        for (size_t i = activeCount; i-- > 0; )
+        {
+            if (!pfds[i].revents)
+                continue;
+
+            int err = 0;
+            socklen_t errLen = sizeof(err);
+            getsockopt(active[i].fd, SOL_SOCKET, SO_ERROR, &err, &errLen);
+            if (!err && winner == -1)
+            {
+                record(active[i].ca, AttemptResult_Success, now - active[i].startUs);
+                winner = active[i].fd;
+            }
+            else
+            {
+                if (err)
+                    record(active[i].ca, AttemptResult_Failure, 0);
+                close(active[i].fd);
+                nextStartUs = now;
+            }
+            active[i] = active[--activeCount];
+        }
+    }
+
+    for (size_t i = 0; i < activeCount; i++)
+        close(active[i].fd);
+    return winner;
+}
+
+int Connect_open(const char* host, const char* port)
+{
+    ConnectAddr_t candidates[CONNECT_MAX_CANDIDATES];
+    size_t count = resolve(host, port, CONNECT_CACHE_TTL_SECONDS * 1000000ULL, candidates);
+    if (!count)
+        return -1;
+
+    int winner = race(candidates, count);
+    if (winner == -1)
+    {
+        // the host may have moved; retry only if re-resolving changed something
+        ConnectAddr_t renewed[CONNECT_MAX_CANDIDATES];
+        size_t renewedCount = resolve(host, port, CONNECT_RERESOLVE_MIN_SECONDS * 1000000ULL, renewed);
+        if (renewedCount && (renewedCount != count || memcmp(renewed, candidates, count * sizeof(ConnectAddr_t))))
+            winner = race(renewed, renewedCount);
+    }
+
+    if (winner == -1)
+    {
+        fprintf(stderr, "client: failed to connect\n");
+        return -2;
+    }
+    return finish(winner);
+}
+
+size_t Connect_prefetch(const char* host, const char* port)
+{
+    ConnectAddr_t addrs[CONNECT_MAX_CANDIDATES];
+    return resolve(host, port, CONNECT_CACHE_TTL_SECONDS * 1000000ULL, addrs);
+}
+
+static bool toPeer(const struct sockaddr_storage* sa, ConnectPeer_t* out)
+{
+    memset(out, 0, sizeof(*out));
+    if (sa->ss_family == AF_INET)
+    {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)sa;
+        out->addr.s6_addr[10] = 0xff;
+        out->addr.s6_addr[11] = 0xff;
+        memcpy(&out->addr.s6_addr[12], &in->sin_addr, 4);
+        out->port = ntohs(in->sin_port);
+        return true;
+    }
+    if (sa->ss_family == AF_INET6)
+    {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*)sa;
+        out->addr = in6->sin6_addr;
+        out->port = ntohs(in6->sin6_port);
+        return true;
+    }
+    return false;
+}
+
+size_t Connect_lookupPeers(const char* host, const char* port, ConnectPeer_t* out)
+{
+    ConnectAddr_t addrs[CONNECT_MAX_CANDIDATES];
+    size_t count = resolve(host, port, CONNECT_CACHE_TTL_SECONDS * 1000000ULL, addrs);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++)
+        n += toPeer(&addrs[i].addr, &out[n]);
+    return n;
+}
+
+bool Connect_peerOf(int fd, ConnectPeer_t* out)
+{
+    struct sockaddr_storage peer;
+    socklen_t len = sizeof(peer);
+    return !getpeername(fd, (struct sockaddr*)&peer, &len) && toPeer(&peer, out);
+}
+
+void Connect_cacheStats(ConnectCacheStats_t* out)
+{
+    pthread_mutex_lock(&cacheLock);
+    *out = cacheStats;
+    pthread_mutex_unlock(&cacheLock);
+}
+
+size_t Connect_formatStats(char* buf, size_t bufLen)
+{
+    size_t off = 0;
+    buf[0] = '\0';
+
+    pthread_mutex_lock(&statsLock);
+    for (size_t i = 0; i < CONNECT_STATS_SLOTS && off < bufLen; i++)
+    {
+        const ConnectAddrStats_t* s = &stats[i];
+        if (!s->addr[0])
+            continue;
+
+        off += (size_t)snprintf(buf + off, bufLen - off, "%s%s ok=%u fail=%u timeout=%u last/avg/max=%.1fms/%.1fms/%.1fms",
+            off ? "; " : "", s->addr, s->successes, s->failures, s->timeouts,
+            s->lastUs / 1000.0, s->successes ? s->totalUs / 1000.0 / s->successes : 0.0, s->maxUs / 1000.0);
+    }
+    pthread_mutex_unlock(&statsLock);
+
+    ConnectCacheStats_t cs;
+    Connect_cacheStats(&cs);
+    if (off < bufLen)
+        off += (size_t)snprintf(buf + off, bufLen - off, "%sdns hit=%llu resolve=%llu stale=%llu coalesced=%llu fail=%llu",
+            off ? "; " : "", (unsigned long long)cs.hits, (unsigned long long)cs.resolves,
+            (unsigned long long)cs.staleServed, (unsigned long long)cs.coalesced, (unsigned long long)cs.resolveFailures);
+    return off < bufLen ? off : bufLen - 1;
+}
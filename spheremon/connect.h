@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+// Non-blocking TCP connect with bounded latency. Resolved addresses are
+// interleaved by family, IPv6 first (RFC 8305 "Happy Eyeballs"), and a new
+// attempt starts every CONNECT_ATTEMPT_DELAY_MS, or immediately when the
+// previous one fails, without abandoning the earlier ones. The first to
+// complete wins. Each attempt is cut off after CONNECT_ATTEMPT_TIMEOUT_MS, so
+// a dead address can't hold a connect up for the kernel's SYN timeout.
+//
+// Resolutions are cached per host/port for CONNECT_CACHE_TTL_SECONDS and
+// shared by every connection creator. Only one caller at a time resolves a
+// given host: while it refreshes an expired entry the rest keep using the
+// stale addresses, and when there are none yet they wait for its answer
+// instead of each running their own lookup. A failed lookup keeps the stale
+// addresses too, so slow or flaky DNS costs one lookup at a time. When
+// no cached address is reachable, the entry is re-resolved (at most every
+// CONNECT_RERESOLVE_MIN_SECONDS) and the race runs again on the new addresses.
+
+#define CONNECT_ATTEMPT_DELAY_MS 250
+#define CONNECT_ATTEMPT_TIMEOUT_MS 3000
+#define CONNECT_MAX_CANDIDATES 8
+#define CONNECT_STATS_SLOTS 8
+#define CONNECT_CACHE_SLOTS 16         // sentinels + primary + every extra target, with room to spare
+#define CONNECT_CACHE_TTL_SECONDS 300
+#define CONNECT_RERESOLVE_MIN_SECONDS 5
+
+typedef struct ConnectAddrStats
+{
+    char addr[INET6_ADDRSTRLEN];
+    uint32_t successes;
+    uint32_t failures;
+    uint32_t timeouts;
+    uint32_t lastUs;            // latency of the most recent success
+    uint32_t maxUs;
+    uint64_t totalUs;           // over successes
+    uint64_t lastAttemptUs;
+} ConnectAddrStats_t;
+
+// Returns a connected, blocking socket; -1 if host didn't resolve, -2 if no
+// address could be reached (the same codes RedisConnect always returned).
+int Connect_open(const char* host, const char* port);
+
+// Resolves host into the cache ahead of the first connect; returns the
+// number of addresses, 0 if it didn't resolve.
+size_t Connect_prefetch(const char* host, const char* port);
+
+// A peer address in one comparable form: IPv4 is kept as its v4-mapped IPv6
+// address, so a socket's peer matches however the address was spelled.
+typedef struct ConnectPeer
+{
+    struct in6_addr addr;
+    uint16_t port;
+} ConnectPeer_t;
+
+// host's addresses (through the cache), up to CONNECT_MAX_CANDIDATES; returns
+// the count, 0 if it didn't resolve.
+size_t Connect_lookupPeers(const char* host, const char* port, ConnectPeer_t* out);
+
+// fd's remote address; false if it has none.
+bool Connect_peerOf(int fd, ConnectPeer_t* out);
+
+typedef struct ConnectCacheStats
+{
+    uint64_t hits;
+    uint64_t resolves;
+    uint64_t staleServed;       // expired or failed-lookup entries used anyway
+    uint64_t coalesced;         // waited on another caller's lookup
+    uint64_t resolveFailures;
+} ConnectCacheStats_t;
+
+void Connect_cacheStats(ConnectCacheStats_t* out);
+
+// "addr ok=N fail=N timeout=N last/avg/max=Xms/Yms/Zms; ..." for each
+// address tried recently, then the cache counters.
+size_t Connect_formatStats(char* buf, size_t bufLen);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Cache-line padded, single-writer counters. Every counter spheremon keeps is
+// updated by exactly one thread, so each sits on its own line (no false
+// sharing with its neighbours or the readers' other data) and increments are
+// a plain load/store pair published with release, with no locked
+// read-modify-write. Snapshots load with acquire from any thread.
+
+#define COUNTER_CACHE_LINE 64
+
+typedef struct Counter
+{
+    _Alignas(COUNTER_CACHE_LINE) _Atomic int64_t value;
+} Counter_t;
+
+// Only the counter's one writer may call Counter_add/Counter_set.
+static inline void Counter_add(Counter_t* c, int64_t n)
+{
+    atomic_store_explicit(&c->value, atomic_load_explicit(&c->value, memory_order_relaxed) + n, memory_order_release);
+}
+
+static inline void Counter_set(Counter_t* c, int64_t n)
+{
+    atomic_store_explicit(&c->value, n, memory_order_release);
+}
+
+static inline int64_t Counter_read(Counter_t* c)
+{
+    return atomic_load_explicit(&c->value, memory_order_acquire);
+}
@@ -0,0 +1,106 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <applibs/gpio.h>
+#include <applibs/networking.h>
+
+#include "hostgpio.h"
+
+// fds handed out for GPIOs sit well above anything the process opens, so a
+// stray close() or write() on one fails instead of hitting a socket
+#define GPIO_FD_BASE 0x4000
+
+typedef struct HostGpio
+{
+    _Atomic bool open;
+    _Atomic GPIO_Value_Type value;
+    _Atomic uint64_t writes;
+    _Atomic uint64_t changes;
+} HostGpio_t;
+
+static HostGpio_t gpios[HOST_GPIO_MAX];
+
+static HostGpio_t* fromFd(int gpioFd)
+{
+    int id = gpioFd - GPIO_FD_BASE;
+    if (id < 0 || id >= HOST_GPIO_MAX || !atomic_load(&gpios[id].open))
+    {
+        errno = EBADF;
+        return NULL;
+    }
+    return &gpios[id];
+}
+
+int GPIO_OpenAsOutput(GPIO_Id gpioId, GPIO_OutputMode_Type outputMode, GPIO_Value_Type initialValue)
+{
+    if (gpioId < 0 || gpioId >= HOST_GPIO_MAX)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    HostGpio_t* gpio = &gpios[gpioId];
+    if (atomic_exchange(&gpio->open, true))
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    static _Atomic bool reportRegistered;
+    if (getenv("SPHEREMON_HOST_GPIO_REPORT") && !atomic_exchange(&reportRegistered, true))
+        atexit(HostGpio_report);
+
+    atomic_store(&gpio->value, initialValue);
+    return GPIO_FD_BASE + gpioId;
+}
+
+int GPIO_SetValue(int gpioFd, GPIO_Value_Type value)
+{
+    HostGpio_t* gpio = fromFd(gpioFd);
+    if (!gpio)
+        return -1;
+
+    atomic_fetch_add_explicit(&gpio->writes, 1, memory_order_relaxed);
+    if (atomic_exchange_explicit(&gpio->value, value, memory_order_relaxed) != value)
+        atomic_fetch_add_explicit(&gpio->changes, 1, memory_order_relaxed);
+    return 0;
+}
+
+int GPIO_GetValue(int gpioFd, GPIO_Value_Type* outValue)
+{
+    HostGpio_t* gpio = fromFd(gpioFd);
+    if (!gpio)
+        return -1;
+
+    *outValue = atomic_load_explicit(&gpio->value, memory_order_relaxed);
+    return 0;
+}
+
+int Networking_IsNetworkingReady(bool* outIsNetworkingReady)
+{
+    *outIsNetworkingReady = true;
+    return 0;
+}
+
+bool HostGpio_stats(GPIO_Id gpioId, HostGpioStats_t* out)
+{
+    if (gpioId < 0 || gpioId >= HOST_GPIO_MAX || !atomic_load(&gpios[gpioId].open))
+        return false;
+
+    out->open = true;
+    out->value = atomic_load(&gpios[gpioId].value);
+    out->writes = atomic_load(&gpios[gpioId].writes);
+    out->changes = atomic_load(&gpios[gpioId].changes);
+    return true;
+}
+
+void HostGpio_report(void)
+{
+    HostGpioStats_t stats;
+    for (GPIO_Id id = 0; id < HOST_GPIO_MAX; id++)
+        if (HostGpio_stats(id, &stats))
+            fprintf(stderr, "gpio %d: value=%u writes=%llu changes=%llu\n", id, stats.value,
+                (unsigned long long)stats.writes, (unsigned long long)stats.changes);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host build stand-in for the Azure Sphere applibs GPIO API: the subset
+// spheremon uses, with the same names and signatures. Nothing touches real
+// hardware; writes land in an in-memory table (see hostgpio.h), so LED
+// traffic costs what a function call costs and can still be inspected.
+
+typedef int GPIO_Id;
+typedef uint8_t GPIO_Value_Type;
+typedef uint8_t GPIO_OutputMode_Type;
+
+typedef enum
+{
+    GPIO_Value_Low = 0,
+    GPIO_Value_High = 1
+} GPIO_Value;
+
+typedef enum
+{
+    GPIO_OutputMode_PushPull = 0,
+    GPIO_OutputMode_OpenDrain = 1,
+    GPIO_OutputMode_OpenSource = 2
+} GPIO_OutputMode;
+
+int GPIO_OpenAsOutput(GPIO_Id gpioId, GPIO_OutputMode_Type outputMode, GPIO_Value_Type initialValue);
+int GPIO_SetValue(int gpioFd, GPIO_Value_Type value);
+int GPIO_GetValue(int gpioFd, GPIO_Value_Type* outValue);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Host build stand-in for the Azure Sphere applibs networking API. A Linux
+// box is taken to be online, so this always reports networking ready and
+// spheremon skips straight past its network wait.
+
+int Networking_IsNetworkingReady(bool* outIsNetworkingReady);
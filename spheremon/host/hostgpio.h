@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <applibs/gpio.h>
+
+// What the host GPIO shim has seen, per GPIO id: its current value, how many
+// GPIO_SetValue calls it got and how many of those changed the value. The
+// counts are atomics, so a benchmark can read them while spheremon's threads
+// write. Set SPHEREMON_HOST_GPIO_REPORT in the environment to have the
+// table printed to stderr at exit.
+
+#define HOST_GPIO_MAX 64
+
+typedef struct HostGpioStats
+{
+    bool open;
+    GPIO_Value_Type value;
+    uint64_t writes;
+    uint64_t changes;
+} HostGpioStats_t;
+
+// False for ids that were never opened.
+bool HostGpio_stats(GPIO_Id gpioId, HostGpioStats_t* out);
+
+void HostGpio_report(void);
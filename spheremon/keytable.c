@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "keytable.h"
+
+#define BITMAP_WORDS(n) (((n) + 31) / 32)
+
+void KeyTable_init(KeyTable_t* table)
+{
+    pthread_rwlock_init(&table->lock, NULL);
+    table->count = 0;
+    table->names = NULL;
+    table->lost = NULL;
+    atomic_init(&table->lostCount, 0);
+}
+
+bool KeyTable_rebuild(KeyTable_t* table, RedisArray_t** sets, size_t setCount)
+{
+    size_t count = 0;
+    for (size_t s = 0; s < setCount; s++)
+        count += sets[s]->count;
+
+    const char** names = (const char**)malloc((count ? count : 1) * sizeof(char*));
+    _Atomic uint32_t* lost = (_Atomic uint32_t*)calloc(BITMAP_WORDS(count) + 1, sizeof(uint32_t));
+    if (!names || !lost)
+    {
+        free(names);
+        free((void*)lost);
+        return false;
+    }
+
+    size_t i = 0;
+    for (size_t s = 0; s < setCount; s++)
+        for (size_t k = 0; k < sets[s]->count; k++)
+            names[i++] = (const char*)sets[s]->objects[k].obj;
+
+    pthread_rwlock_wrlock(&table->lock);
+    free(table->names);
+    free((void*)table->lost);
+    table->names = names;
+    table->lost = lost;
+    table->count = count;
+    atomic_store(&table->lostCount, 0);
+    pthread_rwlock_unlock(&table->lock);
+    return true;
+}
+
+void KeyTable_setLost(KeyTable_t* table, size_t idx, bool lost)
+{
+    uint32_t bit = 1u << (idx % 32);
+    _Atomic uint32_t* word = &table->lost[idx / 32];
+    bool wasLost = atomic_load_explicit(word, memory_order_relaxed) & bit;
+
+    if (lost == wasLost)
+        return;
+
+    if (lost)
+    {
+        atomic_fetch_or_explicit(word, bit, memory_order_relaxed);
+        atomic_fetch_add_explicit(&table->lostCount, 1, memory_order_relaxed);
+    }
+    else
+    {
+        atomic_fetch_and_explicit(word, ~bit, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&table->lostCount, 1, memory_order_relaxed);
+    }
+}
+
+size_t KeyTable_formatLost(KeyTable_t* table, size_t cursor, size_t limit, char* out, size_t outLen)
+{
+    pthread_rwlock_rdlock(&table->lock);
+
+    // leave room to rewrite the header once the next cursor is known
+    static const size_t headerLen = 2 * 21;
+    size_t off = headerLen, written = 0, consumed = 0, next = 0;
+    bool stopped = false;
+
+    for (size_t w = cursor / 32; w < BITMAP_WORDS(table->count) && !stopped; w++)
+    {
+        uint32_t bits = atomic_load_explicit(&table->lost[w], memory_order_relaxed);
+        if (w == cursor / 32)
+            bits &= ~0u << (cursor % 32);
+
+        while (bits)
+        {
+            size_t idx = w * 32 + (size_t)__builtin_ctz(bits);
+            bits &= bits - 1;
+
+            size_t len = strlen(table->names[idx]);
+            bool fits = off + 1 + len < outLen;
+            if (consumed && (written >= limit || !fits))
+            {
+                // every call consumes at least one entry, so a resume point is never 0
+                next = idx;
+                stopped = true;
+                break;
+            }
+
+            // a name that can never fit is skipped rather than stalling the cursor
+            consumed++;
+            if (!fits)
+                continue;
+
+            out[off++] = ' ';
+            memcpy(out + off, table->names[idx], len);
+            off += len;
+            written++;
+        }
+    }
+
+    int h = snprintf(out, outLen, "%zu %zu", atomic_load(&table->lostCount), next);
+    pthread_rwlock_unlock(&table->lock);
+
+    // slide the names down behind the header
+    if (h > 0 && (size_t)h < headerLen && off < outLen)
+    {
+        memmove(out + h, out + headerLen, off - headerLen);
+        out[h + off - headerLen] = '\0';
+    }
+    return written;
+}
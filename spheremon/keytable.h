@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <yarl.h>
+
+// Flat table of every tracked key across all key sets, with a bitmap of the
+// keys found missing by the last sweep. The sweep flips bits without locking;
+// the lock is only taken for writing while the table is rebuilt, so readers
+// walking names can't see them freed.
+
+typedef struct KeyTable
+{
+    pthread_rwlock_t lock;
+    size_t count;
+    const char** names;             // point into the key sets' bulk strings
+    _Atomic uint32_t* lost;         // bit i set = names[i] missing at the last sweep
+    _Atomic size_t lostCount;
+} KeyTable_t;
+
+void KeyTable_init(KeyTable_t* table);
+
+// Replaces the table with the keys of sets; the caller may free the previous
+// sets once this returns. False (table unchanged) on allocation failure.
+bool KeyTable_rebuild(KeyTable_t* table, RedisArray_t** sets, size_t setCount);
+
+// Sweep-side update; only the thread that rebuilds the table may call this.
+void KeyTable_setLost(KeyTable_t* table, size_t idx, bool lost);
+
+// Writes "<lost> <next-cursor> <name> <name> ..." for lost keys at table index
+// >= cursor, stopping after limit names or when the next name won't fit. At
+// least one lost key is always consumed (a limit of 0 acts as 1, and a name
+// longer than out is skipped), so a resume cursor is never 0 and a next-cursor
+// of 0 means the listing is complete. Names are copied straight from the
+// table into out. Returns the number of names written.
+size_t KeyTable_formatLost(KeyTable_t* table, size_t cursor, size_t limit, char* out, size_t outLen);
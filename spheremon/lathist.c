@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lathist.h"
+
+#define SUB_COUNT (1u << LATHIST_SUB_BITS)
+
+static size_t bucketOf(uint64_t us)
+{
+    // values below SUB_COUNT get a bucket each; above that, the top set bit
+    // picks the power of two and the next LATHIST_SUB_BITS bits the quarter
+    if (us < SUB_COUNT)
+        return (size_t)us;
+
+    unsigned msb = 63 - (unsigned)__builtin_clzll(us);
+    unsigned sub = (unsigned)(us >> (msb - LATHIST_SUB_BITS)) & (SUB_COUNT - 1);
+    size_t b = (size_t)(msb - LATHIST_SUB_BITS + 1) * SUB_COUNT + sub;
+    return b < LATHIST_BUCKETS ? b : LATHIST_BUCKETS - 1;
+}
+
+// largest value that lands in bucket b
+static uint64_t bucketTop(size_t b)
+{
+    if (b < SUB_COUNT)
+        return b;
+
+    unsigned msb = (unsigned)(b / SUB_COUNT) + LATHIST_SUB_BITS - 1;
+    uint64_t sub = b % SUB_COUNT;
+    if (msb >= 63)
+        return UINT64_MAX;
+    return ((SUB_COUNT + sub + 1) << (msb - LATHIST_SUB_BITS)) - 1;
+}
+
+void LatHist_record(LatHist_t* h, uint64_t us)
+{
+    atomic_fetch_add_explicit(&h->buckets[bucketOf(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    if (us > atomic_load_explicit(&h->maxUs, memory_order_relaxed))
+        atomic_store_explicit(&h->maxUs, us, memory_order_relaxed);
+}
+
+bool LatHist_recordPayload(LatHist_t* h, const char* payload)
+{
+    if (strncmp(payload, LATENCY_PROBE_TAG, sizeof(LATENCY_PROBE_TAG) - 1))
+        return false;
+
+    char* end;
+    uint64_t sentNs = strtoull(payload + sizeof(LATENCY_PROBE_TAG) - 1, &end, 10);
+    if (end == payload + sizeof(LATENCY_PROBE_TAG) - 1)
+        return false;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t nowNs = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    LatHist_record(h, nowNs > sentNs ? (nowNs - sentNs) / 1000 : 0);
+    return true;
+}
+
+uint64_t LatHist_percentileUs(LatHist_t* h, double fraction)
+{
+    uint64_t count = atomic_load(&h->count);
+    if (!count)
+        return 0;
+
+    uint64_t rank = (uint64_t)(fraction * (double)count);
+    rank = rank < count ? rank + 1 : count;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < LATHIST_BUCKETS; b++)
+        if ((seen += atomic_load_explicit(&h->buckets[b], memory_order_relaxed)) >= rank)
+        {
+            // the top bucket of the range can't be worse than what was seen
+            uint64_t top = bucketTop(b), maxUs = atomic_load(&h->maxUs);
+            return top < maxUs ? top : maxUs;
+        }
+    return atomic_load(&h->maxUs);
+}
+
+void LatHist_reset(LatHist_t* h)
+{
+    for (size_t b = 0; b < LATHIST_BUCKETS; b++)
+        atomic_store_explicit(&h->buckets[b], 0, memory_order_relaxed);
+    atomic_store(&h->count, 0);
+    atomic_store(&h->maxUs, 0);
+}
+
+size_t LatHist_format(LatHist_t* h, char* buf, size_t bufLen)
+{
+    int n = snprintf(buf, bufLen, "count=%llu p50=%lluus p90=%lluus p99=%lluus p999=%lluus max=%lluus",
+        (unsigned long long)atomic_load(&h->count),
+        (unsigned long long)LatHist_percentileUs(h, 0.50), (unsigned long long)LatHist_percentileUs(h, 0.90),
+        (unsigned long long)LatHist_percentileUs(h, 0.99), (unsigned long long)LatHist_percentileUs(h, 0.999),
+        (unsigned long long)atomic_load(&h->maxUs));
+    return n < 0 ? 0 : (size_t)n < bufLen ? (size_t)n : bufLen - 1;
+}
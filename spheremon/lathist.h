@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Latency histogram for the activity path's benchmark probe. A load
+// generator (bench/pubsub_load.c) starts each payload with LATENCY_PROBE_TAG
+// followed by its CLOCK_MONOTONIC send time in nanoseconds. When spheremon is
+// built with ACTIVITY_LATENCY_PROBE, the activity path records send-to-
+// processed time for those messages. That only means something when both
+// run on one host, which is the point: it's for the host build (see
+// CMakeLists.txt) against a local redis-server.
+//
+// Buckets are log-linear in microseconds: four per power of two, so any
+// reported percentile is at most 25% above the truth, from 1us up past an hour.
+// Recording is one relaxed atomic add per counter, for a single writer with
+// any number of readers.
+
+#define LATENCY_PROBE_TAG "spheremon-bench:"
+#define LATHIST_SUB_BITS 2
+#define LATHIST_BUCKETS (64 << LATHIST_SUB_BITS)
+
+typedef struct LatHist
+{
+    _Atomic uint64_t buckets[LATHIST_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t maxUs;
+} LatHist_t;
+
+void LatHist_record(LatHist_t* h, uint64_t us);
+
+// Records the latency of a tagged payload sent at its embedded time; false
+// (and nothing recorded) if payload isn't tagged.
+bool LatHist_recordPayload(LatHist_t* h, const char* payload);
+
+// Upper bound of the bucket holding the given fraction (0..1) of samples.
+uint64_t LatHist_percentileUs(LatHist_t* h, double fraction);
+
+// Racy against a concurrent record, which then lands in either interval.
+void LatHist_reset(LatHist_t* h);
+
+// "count=N p50=Nus p90=Nus p99=Nus p999=Nus max=Nus"
+size_t LatHist_format(LatHist_t* h, char* buf, size_t bufLen);
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "led.h"
+
+void Led_init(LedBank_t* bank, const int* fds, const char* const* names, size_t count,
+    GPIO_Value_Type on, GPIO_Value_Type off)
+{
+    memset(bank, 0, sizeof(*bank));
+    bank->count = count < LED_MAX ? count : LED_MAX;
+    bank->on = on;
+    bank->off = off;
+
+    for (size_t i = 0; i < bank->count; i++)
+    {
+        Led_t* led = &bank->leds[i];
+        led->fd = fds[i];
+        led->name = names[i];
+        led->shadow = -1;
+        pthread_mutex_init(&led->lock, NULL);
+    }
+}
+
+// with led->lock held
+static void writeLocked(Led_t* led, GPIO_Value_Type value)
+{
+    if (led->shadow == (int)value)
+    {
+        atomic_fetch_add_explicit(&led->suppressed, 1, memory_order_relaxed);
+        return;
+    }
+
+    GPIO_SetValue(led->fd, value);
+    led->shadow = (int)value;
+    atomic_fetch_add_explicit(&led->issued, 1, memory_order_relaxed);
+}
+
+void Led_set(LedBank_t* bank, size_t led, bool on)
+{
+    Led_t* l = &bank->leds[led];
+    pthread_mutex_lock(&l->lock);
+    writeLocked(l, on ? bank->on : bank->off);
+    pthread_mutex_unlock(&l->lock);
+}
+
+void Led_setAll(LedBank_t* bank, bool on)
+{
+    for (size_t i = 0; i < bank->count; i++)
+        Led_set(bank, i, on);
+}
+
+size_t Led_formatStats(LedBank_t* bank, char* buf, size_t bufLen)
+{
+    size_t off = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < bank->count && off < bufLen; i++)
+    {
+        Led_t* l = &bank->leds[i];
+        off += (size_t)snprintf(buf + off, bufLen - off, "%s%s issued=%llu suppressed=%llu",
+            i ? "; " : "", l->name,
+            (unsigned long long)atomic_load_explicit(&l->issued, memory_order_relaxed),
+            (unsigned long long)atomic_load_explicit(&l->suppressed, memory_order_relaxed));
+    }
+    return off < bufLen ? off : bufLen - 1;
+}
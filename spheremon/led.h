@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <applibs/gpio.h>
+
+// LED output with shadow state. Every LED remembers the value last written
+// to its GPIO, and GPIO_SetValue is only issued when that changes, so
+// idempotent writes (all-off on every healthy sweep, say) cost a compare
+// instead of a syscall. Activity no longer flashes per message: the pattern
+// engine (see ledpattern.h) turns the message rate into a blink pattern, so
+// GPIO writes follow the pattern's edges, not the traffic. Issued and
+// suppressed (unchanged) writes are counted per LED.
+
+#define LED_MAX 4
+
+typedef struct Led
+{
+    int fd;
+    const char* name;
+    pthread_mutex_t lock;           // keeps shadow and the GPIO in step
+    int shadow;                     // last value written, -1 before the first
+    _Atomic uint64_t issued;
+    _Atomic uint64_t suppressed;
+} Led_t;
+
+typedef struct LedBank
+{
+    Led_t leds[LED_MAX];
+    size_t count;
+    GPIO_Value_Type on;
+    GPIO_Value_Type off;
+} LedBank_t;
+
+// fds and names are in LED index order; on/off are the GPIO values that
+// light and darken them.
+void Led_init(LedBank_t* bank, const int* fds, const char* const* names, size_t count,
+    GPIO_Value_Type on, GPIO_Value_Type off);
+
+void Led_set(LedBank_t* bank, size_t led, bool on);
+void Led_setAll(LedBank_t* bank, bool on);
+
+// "<name> issued=N suppressed=N; ..."
+size_t Led_formatStats(LedBank_t* bank, char* buf, size_t bufLen);
@@ -0,0 +1,281 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "ledpattern.h"
+#include "shutdown.h"
+
+#define MS_NS 1000000ULL
+#define NEVER UINT64_MAX
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// log2(x) in 8.8 fixed point: the integer part from the top set bit and the
+// fraction linearly from the bits below it, within 0.09 of the real thing,
+// which is far finer than an LED shows
+static uint32_t log2Q8(uint32_t x)
+{
+    if (!x)
+        return 0;
+
+    uint32_t msb = 31 - (uint32_t)__builtin_clz(x);
+    uint32_t frac = msb >= 8 ? (x >> (msb - 8)) & 0xFF : (x << (8 - msb)) & 0xFF;
+    return (msb << 8) | frac;
+}
+
+uint32_t LedEngine_dutyForRate(uint32_t perSecond, uint32_t fullPerSecond)
+{
+    if (perSecond >= fullPerSecond)
+        return LED_DUTY_MAX;
+    return log2Q8(perSecond + 1) * LED_DUTY_MAX / log2Q8(fullPerSecond + 1);
+}
+
+bool LedEngine_init(LedEngine_t* e, const LedPattern_t* patterns, size_t count)
+{
+    memset(e, 0, sizeof(*e));
+    e->patterns = patterns;
+    e->count = count < LED_ENGINE_MAX_PATTERNS ? count : LED_ENGINE_MAX_PATTERNS;
+    e->timerFd = -1;
+    e->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    for (size_t i = 0; i < LED_MAX; i++)
+        e->shown[i].pattern = -1;
+    return e->wakeFd >= 0;
+}
+
+static void wake(LedEngine_t* e)
+{
+    uint64_t one = 1;
+    (void)!write(e->wakeFd, &one, sizeof(one));
+}
+
+void LedEngine_raise(LedEngine_t* e, size_t pattern, uint32_t param)
+{
+    uint32_t bit = 1u << pattern;
+    uint32_t old = atomic_exchange_explicit(&e->params[pattern], param, memory_order_relaxed);
+    // re-raising what's already showing is free
+    if ((atomic_fetch_or(&e->raised, bit) & bit) && old == param)
+        return;
+    wake(e);
+}
+
+void LedEngine_clear(LedEngine_t* e, size_t pattern)
+{
+    uint32_t bit = 1u << pattern;
+    if (atomic_fetch_and(&e->raised, ~bit) & bit)
+        wake(e);
+}
+
+// length of one cycle of pattern p with parameter param; 0 if it's dark
+static uint64_t cycleNs(const LedPattern_t* p, uint32_t param)
+{
+    uint64_t ms = 0;
+    switch (p->kind)
+    {
+    case LedPattern_Steady:
+        return NEVER;
+    case LedPattern_Sequence:
+        for (size_t i = 0; i < p->stepCount; i++)
+            ms += p->steps[i].ms;
+        break;
+    case LedPattern_Pulses:
+        ms = param ? (uint64_t)param * (p->onMs + p->offMs) + p->gapMs : 0;
+        break;
+    case LedPattern_Duty:
+        ms = param ? p->frameMs : 0;
+        break;
+    }
+    return ms * MS_NS;
+}
+
+// whether pattern p is lit at pos into its cycle, and where in the cycle
+// that changes next
+static bool litAt(const LedPattern_t* p, uint32_t param, uint64_t pos, uint64_t cycle, uint64_t* edge)
+{
+    *edge = cycle;
+    switch (p->kind)
+    {
+    case LedPattern_Steady:
+        return true;
+
+    case LedPattern_Sequence:
+    {
+        uint64_t end = 0;
+        for (size_t i = 0; i < p->stepCount; i++)
+        {
+            end += p->steps[i].ms * MS_NS;
+            if (pos < end)
+            {
+                *edge = end;
+                return p->steps[i].on;
+            }
+        }
+        return false;
+    }
+
+    case LedPattern_Pulses:
+    {
+        uint64_t unit = (p->onMs + p->offMs) * MS_NS;
+        if (pos >= (uint64_t)param * unit)
+            return false;
+        uint64_t unitStart = pos / unit * unit;
+        bool on = pos - unitStart < p->onMs * MS_NS;
+        *edge = unitStart + (on ? p->onMs * MS_NS : unit);
+        return on;
+    }
+
+    case LedPattern_Duty:
+    {
+        uint64_t onNs = cycle * (param < LED_DUTY_MAX ? param : LED_DUTY_MAX) / LED_DUTY_MAX;
+        if (pos < onNs)
+        {
+            *edge = onNs;
+            return true;
+        }
+        return false;
+    }
+    }
+    return false;
+}
+
+// decides one LED's state at now; returns when it next changes
+static uint64_t render(LedEngine_t* e, size_t led, uint32_t raised, uint64_t now)
+{
+    int best = -1;
+    for (size_t i = 0; i < e->count; i++)
+        if ((raised & (1u << i)) && e->patterns[i].led == led
+            && (best < 0 || e->patterns[i].priority > e->patterns[best].priority))
+            best = (int)i;
+
+    LedShown_t* shown = &e->shown[led];
+    if (best < 0)
+    {
+        shown->pattern = -1;
+        Led_set(e->bank, led, false);
+        return NEVER;
+    }
+
+    const LedPattern_t* p = &e->patterns[best];
+    uint64_t cycle = cycleNs(p, shown->param);
+    // a new pattern, a finished cycle, or a dark one that may have been
+    // given a parameter: start a cycle now with the current parameter
+    if (shown->pattern != best || !cycle || (cycle != NEVER && now - shown->cycleStartNs >= cycle))
+    {
+        shown->pattern = best;
+        shown->param = atomic_load_explicit(&e->params[best], memory_order_relaxed);
+        shown->cycleStartNs = now;
+        cycle = cycleNs(p, shown->param);
+    }
+
+    if (!cycle)
+    {
+        Led_set(e->bank, led, false);
+        return NEVER;
+    }
+
+    uint64_t edge;
+    bool on = litAt(p, shown->param, now - shown->cycleStartNs, cycle, &edge);
+    Led_set(e->bank, led, on);
+    return edge == NEVER ? NEVER : shown->cycleStartNs + edge;
+}
+
+static void* engineFunc(void* arg)
+{
+    LedEngine_t* e = (LedEngine_t*)arg;
+
+    for (;;)
+    {
+        uint64_t now = nowNs();
+        uint32_t raised = atomic_load(&e->raised);
+        uint64_t next = NEVER;
+        for (size_t led = 0; led < e->bank->count; led++)
+        {
+            uint64_t at = render(e, led, raised, now);
+            next = at < next ? at : next;
+        }
+
+        // a zero it_value disarms, which is what NEVER wants
+        struct itimerspec spec = { 0 };
+        if (next != NEVER)
+        {
+            next = next > now ? next : now + 1;
+            spec.it_value.tv_sec = (time_t)(next / 1000000000ULL);
+            spec.it_value.tv_nsec = (long)(next % 1000000000ULL);
+        }
+        timerfd_settime(e->timerFd, TFD_TIMER_ABSTIME, &spec, NULL);
+
+        struct pollfd pfds[3] = {
+            { .fd = e->timerFd, .events = POLLIN },
+            { .fd = e->wakeFd, .events = POLLIN },
+            { .fd = Shutdown_fd(), .events = POLLIN }
+        };
+        while (poll(pfds, 3, -1) < 0 && errno == EINTR)
+            ;
+        if (Shutdown_requested())
+            break;
+
+        uint64_t drained;
+        if (pfds[0].revents & POLLIN)
+            (void)!read(e->timerFd, &drained, sizeof(drained));
+        if (pfds[1].revents & POLLIN)
+            (void)!read(e->wakeFd, &drained, sizeof(drained));
+        atomic_fetch_add_explicit(&e->wakeups, 1, memory_order_relaxed);
+    }
+
+    Led_setAll(e->bank, false);
+    return NULL;
+}
+
+bool LedEngine_start(LedEngine_t* e, LedBank_t* bank)
+{
+    e->bank = bank;
+    if ((e->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0)
+        return false;
+    if (pthread_create(&e->thread, NULL, engineFunc, e))
+    {
+        close(e->timerFd);
+        e->timerFd = -1;
+        return false;
+    }
+    return true;
+}
+
+void LedEngine_stop(LedEngine_t* e)
+{
+    if (e->timerFd < 0)
+        return;
+    pthread_join(e->thread, NULL);
+    close(e->timerFd);
+    e->timerFd = -1;
+}
+
+size_t LedEngine_format(LedEngine_t* e, char* buf, size_t bufLen)
+{
+    // the engine's view of each LED, read racily: it's a status line
+    size_t off = 0;
+    buf[0] = '\0';
+    for (size_t led = 0; e->bank && led < e->bank->count && off < bufLen; led++)
+    {
+        int p = e->shown[led].pattern;
+        if (p < 0)
+            off += (size_t)snprintf(buf + off, bufLen - off, "%s=dark ", e->bank->leds[led].name);
+        else if (e->patterns[p].kind == LedPattern_Pulses || e->patterns[p].kind == LedPattern_Duty)
+            off += (size_t)snprintf(buf + off, bufLen - off, "%s=%s(%u) ", e->bank->leds[led].name,
+                e->patterns[p].name, e->shown[led].param);
+        else
+            off += (size_t)snprintf(buf + off, bufLen - off, "%s=%s ", e->bank->leds[led].name, e->patterns[p].name);
+    }
+    if (off < bufLen)
+        off += (size_t)snprintf(buf + off, bufLen - off, "wakeups=%llu",
+            (unsigned long long)atomic_load(&e->wakeups));
+    return off < bufLen ? off : bufLen - 1;
+}
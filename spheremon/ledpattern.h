@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "led.h"
+
+// Declarative LED signalling. The application describes each status signal
+// once, in a table of patterns: which LED it drives, its priority, and its
+// on/off sequence. Threads only raise or clear a pattern (with a parameter,
+// such as a pulse count or a duty), which is a couple of atomic stores and
+// a wakeup. One engine thread renders everything. Each LED shows the
+// highest-priority raised pattern aimed at it, or stays dark. The thread
+// sleeps on an absolute CLOCK_MONOTONIC timerfd until the next on/off edge
+// of any LED, so its cost follows the patterns on show, not the traffic or
+// how often they're raised.
+//
+// Kinds:
+//   Steady    on while raised
+//   Sequence  steps, looped
+//   Pulses    param pulses of onMs on and offMs off, then gapMs dark; the
+//             count is re-read each cycle
+//   Duty      param/LED_DUTY_MAX of every frameMs frame on (software PWM)
+//
+// A parameterised pattern raised with 0 (no pulses, no duty) shows dark but
+// still holds its LED against lower priorities.
+
+#define LED_ENGINE_MAX_PATTERNS 16
+#define LED_DUTY_MAX 256
+
+typedef enum LedPatternKind
+{
+    LedPattern_Steady = 0,
+    LedPattern_Sequence,
+    LedPattern_Pulses,
+    LedPattern_Duty
+} LedPatternKind_t;
+
+typedef struct LedStep
+{
+    bool on;
+    uint32_t ms;
+} LedStep_t;
+
+typedef struct LedPattern
+{
+    const char* name;
+    size_t led;
+    int priority;                   // higher wins
+    LedPatternKind_t kind;
+    const LedStep_t* steps;         // Sequence
+    size_t stepCount;
+    uint32_t onMs;                  // Pulses
+    uint32_t offMs;
+    uint32_t gapMs;
+    uint32_t frameMs;               // Duty
+} LedPattern_t;
+
+typedef struct LedShown
+{
+    int pattern;                    // -1 when dark
+    uint32_t param;                 // as of the start of the current cycle
+    uint64_t cycleStartNs;
+} LedShown_t;
+
+typedef struct LedEngine
+{
+    const LedPattern_t* patterns;
+    size_t count;
+    LedBank_t* bank;
+    _Atomic uint32_t raised;        // bit per pattern
+    _Atomic uint32_t params[LED_ENGINE_MAX_PATTERNS];
+    int wakeFd;
+    int timerFd;
+    LedShown_t shown[LED_MAX];      // engine thread only
+    _Atomic uint64_t wakeups;
+    pthread_t thread;
+} LedEngine_t;
+
+// Before any raise; patterns must outlive the engine.
+bool LedEngine_init(LedEngine_t* e, const LedPattern_t* patterns, size_t count);
+
+// Starts rendering onto bank; patterns raised before this show at once.
+bool LedEngine_start(LedEngine_t* e, LedBank_t* bank);
+
+void LedEngine_raise(LedEngine_t* e, size_t pattern, uint32_t param);
+void LedEngine_clear(LedEngine_t* e, size_t pattern);
+
+// Joins the thread once shutdown is requested (see shutdown.h); LEDs end dark.
+void LedEngine_stop(LedEngine_t* e);
+
+// Duty for a message rate: log2(rate + 1) / log2(full + 1), in fixed point.
+uint32_t LedEngine_dutyForRate(uint32_t perSecond, uint32_t fullPerSecond);
+
+// "<led-name>=<pattern>[(param)]|dark ... wakeups=N"
+size_t LedEngine_format(LedEngine_t* e, char* buf, size_t bufLen);
@@ -21,64 +21,33 @@
 
 #include <yarl.h>
 
-// adapted from http://beej.us/guide/bgnet/html/multi/clientserver.html#simpleclient
-
-// get sockaddr, IPv4 or IPv6:
-void *get_in_addr(struct sockaddr *sa)
-{
-    if (sa->sa_family == AF_INET)
-    {
-        return &(((struct sockaddr_in *)sa)->sin_addr);
-    }
-
-    return &(((struct sockaddr_in6 *)sa)->sin6_addr);
-}
-
+#include "resp.h"
+#include "metricsframe.h"
+#include "spool.h"
+#include "rollup.h"
+#include "counters.h"
+#include "replyconn.h"
+#include "commands.h"
+#include "cmdstream.h"
+#include "cmdqueue.h"
+#include "config.h"
+#include "keytable.h"
+#include "mux.h"
+#include "connect.h"
+#include "reconnect.h"
+#include "sentinel.h"
+#include "targets.h"
+#include "startup.h"
+#include "shutdown.h"
+#include "schedule.h"
+#include "led.h"
+#include "ledpattern.h"
+#include "lathist.h"
+
+// bounded, racing connect; see connect.h
 RedisConnection_t RedisConnect(const char *host, const char *port)
 {
-    int sockfd;
-    struct addrinfo hints, *servinfo, *p;
-    int rv;
-    char s[INET6_ADDRSTRLEN];
-
-    memset(&hints, 0, sizeof hints);
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-
-    if ((rv = getaddrinfo(host, port, &hints, &servinfo)) != 0)
-    {
-        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(rv));
-        return -1;
-    }
-
-    // loop through all the results and connect to the first we can
-    for (p = servinfo; p != NULL; p = p->ai_next)
-    {
-        if ((sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) == -1)
-        {
-            perror("client: socket");
-            continue;
-        }
-
-        if (connect(sockfd, p->ai_addr, p->ai_addrlen) == -1)
-        {
-            close(sockfd);
-            perror("client: connect");
-            continue;
-        }
-
-        break;
-    }
-
-    if (p == NULL)
-    {
-        fprintf(stderr, "client: failed to connect\n");
-        return -2;
-    }
-
-    inet_ntop(p->ai_family, get_in_addr((struct sockaddr *)p->ai_addr), s, sizeof s);
-    freeaddrinfo(servinfo); // all done with this structure
-    return (RedisConnection_t)sockfd;
+    return (RedisConnection_t)Connect_open(host, port);
 }
 
 #define WAIT_FOR_WIFI_SECONDS   120
@@ -91,14 +60,21 @@ bool netCheck()
     return Networking_IsNetworkingReady(&netUp) != -1 && netUp;
 }
 
-int checkKeys(RedisConnection_t conn, RedisArray_t *keys)
+// returns the number of lost keys, or -1 if the link failed mid-sweep; keys
+// not reached keep their previous state rather than all reading as lost
+int checkKeys(RedisConnection_t conn, KeyTable_t *keys)
 {
-    assert(keys && keys->count);
+    assert(keys);
     int lostCount = 0;
-    for (int i = 0; i < keys->count; i++)
+    for (size_t i = 0; i < keys->count && !Shutdown_requested(); i++)
     {
-        char *checkKey = (char*)keys->objects[i].obj;
-        lostCount += !Redis_EXISTS(conn, checkKey);
+        // a false EXISTS is either a missing key or a failed read; a PING
+        // tells them apart, and lost keys are rare enough that it's cheap
+        bool lost = !Redis_EXISTS(conn, keys->names[i]);
+        if (lost && !Reconnect_ping(conn))
+            return -1;
+        KeyTable_setLost(keys, i, lost);
+        lostCount += lost;
     }
     return lostCount;
 }
@@ -116,10 +92,39 @@ int checkKeys(RedisConnection_t conn, RedisArray_t *keys)
 #define LOST_LED RED_FDIDX
 #define ACTIVITY_LED GREEN_FDIDX
 #define LOST_PULSE_LED BLUE_FDIDX
+#define ACTIVITY_RATE_FULL 10000    // messages a second for full brightness
+#define SWEEP_REPLY_TIMEOUT_SECONDS 3
 
+// defaults; all of these can be changed at runtime (see config.h)
 #define KEY_CHECK_CADENCE_SECONDS 5
+#define WATCH_INTERVAL_SECONDS 5
+#define SUBSCRIBE_PATTERN "*"
 #define MSG_CADENCE_AMOUNT 10
 
+// when set, the watch thread publishes compact binary frames (see metricsframe.h)
+// on METRICS_FRAME_CHANNEL instead of the text line on spheremon:watchthread
+#ifndef METRICS_BINARY_FRAMES
+#define METRICS_BINARY_FRAMES 0
+#endif
+
+// when set, activity, commands, command replies and metrics all share one
+// RESP3 connection (see mux.h) instead of a RESP2 connection apiece
+#ifndef RESP3_MUX
+#define RESP3_MUX 0
+#endif
+
+// when set, the activity LED's brightness follows the message rate instead
+// of blinking while there is any
+#ifndef ACTIVITY_PWM
+#define ACTIVITY_PWM 1
+#endif
+
+// when set, the activity path times benchmark messages tagged with their send
+// time (see lathist.h); the host build turns it on
+#ifndef ACTIVITY_LATENCY_PROBE
+#define ACTIVITY_LATENCY_PROBE 0
+#endif
+
 int* setupLEDs(void);
 int* setupLEDs()
 {
@@ -141,184 +146,1095 @@ int* setupLEDs()
     return fds;
 }
 
-#define TOGGLE_ALL(fds, val) do { for (int i = 0; i < LED_COUNT; i++) GPIO_SetValue(fds[i], val); } while(0)
-
 typedef struct psubThreadArgs
 {
-    int* fds;
     const char* host;
     const char* port;
     const char* pass;
+    Sentinel_t* sentinel;           // NULL unless host was "sentinel:<name>"
 } psubThreadArgs_t;
 
 int trackedKeyCount = 0;
-int __attribute__((atomic)) msgCount = 0;
-int __attribute__((atomic)) lastLost = 0;
-int __attribute__((atomic)) threadRunningCount = 0;
+RollupStore_t rollups;
+KeyTable_t keyTable;
+CmdQueue_t cmdQueue;
+_Atomic RedisConnection_t activityConn = -1;
+Mux_t mux;
+TargetSet_t targets;            // extra instances from argv[5..]
+Counter_t msgCount;              // written by the activity thread
+Counter_t lastLost;              // written by the main sweep
+Startup_t startup;
+Schedule_t sweepSchedule;        // written by the main sweep
+LedBank_t ledBank;
+LedEngine_t ledEngine;
+LatHist_t activityLatency;       // written by the activity thread
+
+// every status the LEDs show; threads raise and clear these, and the engine
+// thread (see ledpattern.h) is the only one that ever times a blink
+typedef enum LedSignal
+{
+    LedSignal_NetworkWait = 0,
+    LedSignal_NetworkRetry,
+    LedSignal_Connecting,
+    LedSignal_LostKeys,
+    LedSignal_LostPulses,           // one pulse per lost key
+    LedSignal_Activity,
+    LedSignal_Count
+} LedSignal_t;
+
+static const LedStep_t retrySteps[] = { { true, 50 }, { false, 1000 } };
+#if !ACTIVITY_PWM
+static const LedStep_t activitySteps[] = { { true, 50 }, { false, 450 } };
+#endif
+
+static const LedPattern_t ledPatterns[LedSignal_Count] = {
+    [LedSignal_NetworkWait] = { .name = "network-wait", .led = BLUE_FDIDX, .priority = 2,
+        .kind = LedPattern_Steady },
+    [LedSignal_NetworkRetry] = { .name = "network-retry", .led = RED_FDIDX, .priority = 2,
+        .kind = LedPattern_Sequence, .steps = retrySteps, .stepCount = 2 },
+    [LedSignal_Connecting] = { .name = "connecting", .led = GREEN_FDIDX, .priority = 2,
+        .kind = LedPattern_Steady },
+    [LedSignal_LostKeys] = { .name = "lost-keys", .led = LOST_LED, .priority = 1,
+        .kind = LedPattern_Steady },
+    [LedSignal_LostPulses] = { .name = "lost-pulses", .led = LOST_PULSE_LED, .priority = 1,
+        .kind = LedPattern_Pulses, .onMs = 500, .offMs = 500, .gapMs = 1500 },
+#if ACTIVITY_PWM
+    [LedSignal_Activity] = { .name = "activity", .led = ACTIVITY_LED, .priority = 1,
+        .kind = LedPattern_Duty, .frameMs = 10 },
+#else
+    [LedSignal_Activity] = { .name = "activity", .led = ACTIVITY_LED, .priority = 1,
+        .kind = LedPattern_Sequence, .steps = activitySteps, .stepCount = 2 },
+#endif
+};
 static volatile sig_atomic_t running = true;
 
-RedisConnection_t newConnection(psubThreadArgs_t* tArgs)
+// set up alongside the network wait, which the blue LED marks
+static void* gpioSetupFunc(void* arg)
+{
+    static const char* const names[LED_COUNT] = { "red", "green", "blue" };
+    int* fds = setupLEDs();
+    if (!fds)
+    {
+        Startup_fail(&startup, StartupPhase_Gpio);
+        return NULL;
+    }
+
+    Led_init(&ledBank, fds, names, LED_COUNT, LED_ON, LED_OFF);
+    Led_setAll(&ledBank, false);
+    if (!LedEngine_start(&ledEngine, &ledBank))
+    {
+        Startup_fail(&startup, StartupPhase_Gpio);
+        return NULL;
+    }
+    Startup_ready(&startup, StartupPhase_Gpio);
+    return NULL;
+}
+
+static void applySocketProfile(RedisConnection_t conn, SocketRole_t role)
+{
+    Config_t cfg;
+    Config_copy(&cfg);
+    SocketProfile_apply(conn, &cfg.socketProfiles[role]);
+}
+
+// the fixed host and port, or in sentinel mode the current primary
+static void redisEndpoint(psubThreadArgs_t* tArgs, SentinelAddr_t* out)
+{
+    if (!tArgs->sentinel)
+    {
+        snprintf(out->host, sizeof(out->host), "%s", tArgs->host);
+        snprintf(out->port, sizeof(out->port), "%s", tArgs->port);
+        return;
+    }
+
+    Sentinel_primary(tArgs->sentinel, out);
+    if (!out->host[0] && Sentinel_discover(tArgs->sentinel))
+        Sentinel_primary(tArgs->sentinel, out);
+}
+
+// returns a connected (and authenticated) connection, or a value < 1 on failure
+RedisConnection_t tryConnection(psubThreadArgs_t* tArgs, SocketRole_t role)
 {
     assert(tArgs);
-    RedisConnection_t threadConn = RedisConnect(tArgs->host, tArgs->port);
+    SentinelAddr_t endpoint;
+    redisEndpoint(tArgs, &endpoint);
+    RedisConnection_t threadConn = RedisConnect(endpoint.host, endpoint.port);
 
     if (threadConn < 1)
     {
         fprintf(stderr, "RedisConnect failed: %d\n", threadConn);
         fflush(stderr);
-        exit(42);
+        return threadConn;
     }
 
+    applySocketProfile(threadConn, role);
+
     if (tArgs->pass && !Redis_AUTH(threadConn, tArgs->pass))
     {
         fprintf(stderr, "AUTH failed\n");
         fflush(stderr);
-        exit(43);
+        close(threadConn);
+        return -3;
+    }
+
+    if (tArgs->sentinel)
+    {
+        // mid-failover a sentinel can still name the demoted primary
+        if (!Sentinel_isPrimary(threadConn))
+        {
+            fprintf(stderr, "%s:%s is not the primary, asking the sentinels again\n", endpoint.host, endpoint.port);
+            close(threadConn);
+            Sentinel_discover(tArgs->sentinel);
+            return -4;
+        }
+        Sentinel_track(tArgs->sentinel, threadConn);
     }
 
     return threadConn;
 }
 
+// closes a connection from tryConnection; in sentinel mode it's untracked
+// first, so a failover can't cut whichever socket reuses the fd number
+static void closeConnection(void* ctx, RedisConnection_t conn)
+{
+    psubThreadArgs_t* tArgs = (psubThreadArgs_t*)ctx;
+    if (tArgs->sentinel)
+        Sentinel_untrack(tArgs->sentinel, conn);
+    close(conn);
+}
+
+static RedisConnection_t connectSubscriber(void* ctx)
+{
+    return tryConnection((psubThreadArgs_t*)ctx, SocketRole_Subscriber);
+}
+
+static RedisConnection_t connectSweep(void* ctx)
+{
+    // bounds the liveness PING and each EXISTS, so a silently dead primary
+    // is noticed in seconds rather than when keepalive gives up
+    RedisConnection_t conn = tryConnection((psubThreadArgs_t*)ctx, SocketRole_Sweep);
+    if (conn > 0)
+        Resp_setReplyTimeout(conn, SWEEP_REPLY_TIMEOUT_SECONDS);
+    return conn;
+}
+
+static RedisConnection_t connectCommand(void* ctx)
+{
+    return tryConnection((psubThreadArgs_t*)ctx, SocketRole_Command);
+}
+
+static RedisConnection_t connectReply(void* ctx)
+{
+    return tryConnection((psubThreadArgs_t*)ctx, SocketRole_Reply);
+}
+
+static const Reconnect_connect_t linkConnectors[ReconnectLink_Count] = {
+    [ReconnectLink_Sweep] = connectSweep,
+    [ReconnectLink_Activity] = connectSubscriber,
+    [ReconnectLink_Command] = connectCommand,
+    [ReconnectLink_Watch] = connectReply,
+    [ReconnectLink_CommandStream] = connectCommand
+};
+
+// retries with backoff until connected; a value < 1 only once shutting down
+RedisConnection_t newConnection(psubThreadArgs_t* tArgs, ReconnectLink_t link)
+{
+    return Reconnect_until(link, linkConnectors[link], tArgs, &running);
+}
+
+#define WATCH_REPLY_TIMEOUT_SECONDS 2
+
+static uint64_t monotonicMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+// (re)queries the tracked key sets for every configured pattern
+bool loadKeySets(RedisConnection_t conn, const Config_t* cfg, RedisArray_t** keySets, size_t* keySetCount)
+{
+    RedisArray_t* loaded[CONFIG_MAX_PATTERNS];
+    int total = 0;
+
+    for (size_t i = 0; i < cfg->keyPatternCount; i++)
+    {
+        if (!(loaded[i] = Redis_KEYS(conn, cfg->keyPatterns[i])))
+        {
+            fprintf(stderr, "Failed to query key set '%s'\n", cfg->keyPatterns[i]);
+            while (i--)
+                RedisArray_dealloc(loaded[i]);
+            return false;
+        }
+
+        printf("Found %d keys for '%s'\n", (int)loaded[i]->count, cfg->keyPatterns[i]);
+        total += (int)loaded[i]->count;
+    }
+
+    if (!KeyTable_rebuild(&keyTable, loaded, cfg->keyPatternCount))
+    {
+        for (size_t i = 0; i < cfg->keyPatternCount; i++)
+            RedisArray_dealloc(loaded[i]);
+        return false;
+    }
+
+    // the table no longer points into the old sets
+    for (size_t i = 0; i < *keySetCount; i++)
+        RedisArray_dealloc(keySets[i]);
+
+    memcpy(keySets, loaded, cfg->keyPatternCount * sizeof(RedisArray_t*));
+    *keySetCount = cfg->keyPatternCount;
+    trackedKeyCount = total;
+    return true;
+}
+
 void* watchThreadFunc(void* arg)
 {
     assert(arg);
-    RedisConnection_t threadConn = newConnection((psubThreadArgs_t*)arg);
-    static const double SLEEP_TIME_SECONDS = 5.0;
+    double intervalSeconds = WATCH_INTERVAL_SECONDS;
+#if RESP3_MUX
+    RespTransport_t transport = Mux_transport;
+    void* transportCtx = &mux;
+#else
+    psubThreadArgs_t* tArgs = (psubThreadArgs_t*)arg;
+    RedisConnection_t threadConn = newConnection(tArgs, ReconnectLink_Watch);
+    Resp_setReplyTimeout(threadConn, WATCH_REPLY_TIMEOUT_SECONDS);
+    RespTransport_t transport = Resp_connectionTransport;
+    void* transportCtx = &threadConn;
+#endif
     printf("watch thread up and running.\n");
-    threadRunningCount++;
-
-    struct timespec sleepTime = { (time_t)SLEEP_TIME_SECONDS, 0 };
+    Startup_ready(&startup, StartupPhase_Watch);
+
+    // metrics recorded while redis is unreachable; backfilled on reconnect
+    static Spool_t spool;
+    Spool_init(&spool);
+
+    // rollup samples land on a fixed 1 s deadline, so time spent publishing
+    // doesn't stretch a second or shift later ones into the wrong bucket
+    static Schedule_t rollupTick;
+    Schedule_init(&rollupTick);
+    const uint64_t rollupOriginUs = rollupTick.deadlineUs;
+    int rollupLast = (int)Counter_read(&msgCount);
     int last = 0;
     double perSec = 0.0, curPerSec = 0.0;
+    double sampleSeconds = intervalSeconds;     // shorter for the final partial interval
+    bool stopping = false;
     time_t timeIncr = 0;
-    char buf[128];
-    while (running)
+    bool liveSynced = false;
+#if METRICS_BINARY_FRAMES
+    MetricsFrameCodec_t codec;
+    MetricsFrameCodec_init(&codec);
+#endif
+    while (!stopping)
     {
+        // one more pass after shutdown is requested flushes the partial interval
+        stopping = !running;
+        int count = (int)Counter_read(&msgCount);
         if (!last) {
-            perSec = msgCount / SLEEP_TIME_SECONDS;
+            perSec = count / sampleSeconds;
         }
         else {
-            curPerSec = (msgCount - last) / SLEEP_TIME_SECONDS;
+            curPerSec = (count - last) / sampleSeconds;
             perSec = (curPerSec + perSec) / 2;
         }
 
+#if RESP3_MUX
+        bool linked = Mux_isAlive(&mux);
+#else
+        if (threadConn < 1 && !stopping && (threadConn = Reconnect_tryOnce(ReconnectLink_Watch, connectReply, tArgs)) > 0)
+        {
+            Resp_setReplyTimeout(threadConn, WATCH_REPLY_TIMEOUT_SECONDS);
+            printf("watch thread reconnected, %zu spooled (%llu evicted).\n",
+                spool.count, (unsigned long long)spool.evicted);
+        }
+        bool linked = threadConn > 0;
+#endif
+
         if (timeIncr) {
+#if METRICS_BINARY_FRAMES
+            MetricsFrame_t frame = {
+                .perSecX100 = (uint32_t)(perSec * 100),
+                .curPerSecX100 = (uint32_t)(curPerSec * 100),
+                .uptime = (uint64_t)timeIncr,
+                .msgCount = (uint64_t)count,
+                .intervalCount = (uint64_t)(count - last),
+                .trackedKeys = (uint64_t)trackedKeyCount,
+                .lostKeys = (uint64_t)Counter_read(&lastLost)
+            };
+            // spooled frames may be evicted and the live channel may have
+            // missed frames, so start over from a key frame until a live publish succeeds
+            if (!liveSynced)
+                MetricsFrameCodec_requestKeyFrame(&codec);
+
+            uint8_t frameBuf[METRICS_FRAME_MAX_SIZE];
+            size_t frameLen = MetricsFrame_encode(&codec, &frame, frameBuf, sizeof(frameBuf));
+            const char* pubChannel = METRICS_FRAME_CHANNEL;
+            const void* payload = frameBuf;
+            size_t payloadLen = frameLen;
+#if DEBUG
+            char buf[128];
+            MetricsFrame_format(&frame, buf, sizeof(buf));
+            fprintf(stderr, "%s (%zu bytes)\n", buf, frameLen);
+            fflush(stderr);
+#endif
+#else
+            char buf[128];
             bzero(buf, 128);
             snprintf(buf, 128, "[%06d] %-6d %-6d %-3d %5.2f %5.2f %s",
-                timeIncr, msgCount, last, (msgCount - last), 
+                timeIncr, count, last, (count - last), 
                 perSec, curPerSec, (curPerSec > perSec * 1.5 ? "!>!" : (curPerSec < perSec * 0.5 ? "!<!" : "")));
 
-            Redis_PUBLISH(threadConn, "spheremon:watchthread", buf);
+            const char* pubChannel = "spheremon:watchthread";
+            const void* payload = buf;
+            size_t payloadLen = strlen(buf);
 #if DEBUG
             fprintf(stderr, "%s\n", buf);
             fflush(stderr);
 #endif
+#endif
+            liveSynced = linked && Resp_publishVia(transport, transportCtx, pubChannel, payload, payloadLen);
+            bool targetsSent = liveSynced;
+            for (size_t i = 0; i < targets.count && targetsSent; i++)
+            {
+                // extra targets are text only and not spooled: a missed line is just a gap
+                char targetBuf[160], targetChannel[sizeof(TARGET_WATCH_CHANNEL) + TARGET_NAME_LEN];
+                size_t targetLen = Target_formatWatch(&targets.targets[i], (uint64_t)timeIncr, intervalSeconds,
+                    targetBuf, sizeof(targetBuf));
+                snprintf(targetChannel, sizeof(targetChannel), TARGET_WATCH_CHANNEL "%s", targets.targets[i].name);
+                targetsSent = Resp_publishVia(transport, transportCtx, targetChannel, targetBuf, targetLen);
+            }
+            if (!liveSynced)
+            {
+#if METRICS_BINARY_FRAMES
+                if (!(frameBuf[1] & METRICS_FRAME_FLAG_KEY))
+                {
+                    MetricsFrameCodec_requestKeyFrame(&codec);
+                    payloadLen = MetricsFrame_encode(&codec, &frame, frameBuf, sizeof(frameBuf));
+                }
+#endif
+                Spool_push(&spool, payload, payloadLen);
+            }
+
+            // the live channel always gets the current sample; the outage
+            // backlog is replayed onto SPOOL_BACKFILL_KEY a few batches per tick
+            if (linked && (!liveSynced || !targetsSent || (spool.count && !Spool_backfill(&spool, transport, transportCtx))))
+            {
+                fprintf(stderr, "watch thread lost its connection, spooling metrics\n");
+#if !RESP3_MUX
+                closeConnection(tArgs, threadConn);
+                threadConn = -1;
+                Reconnect_lost(ReconnectLink_Watch);
+#endif
+                liveSynced = false;
+            }
         }
 
-        last = msgCount;
-        timeIncr += (time_t)SLEEP_TIME_SECONDS;
-        nanosleep(&sleepTime, NULL);
+        last = count;
+        timeIncr += (time_t)intervalSeconds;
+
+        intervalSeconds = Config_enter(ConfigReader_Watch)->watchIntervalSeconds;
+        Config_exit(ConfigReader_Watch);
+
+        // sleep out the interval a second at a time, feeding the rollups
+        uint64_t sleptFromMs = monotonicMs();
+        for (int s = 0; s < (int)intervalSeconds && !stopping; s++)
+        {
+            bool awake = Schedule_wait(&rollupTick, 1000);
+            int sample = (int)Counter_read(&msgCount);
+            // an overrun re-anchors the deadline, so a bucket can be skipped but
+            // never repeated; a shutdown wake leaves it unmoved, hence the + 1
+            uint32_t second = (uint32_t)((rollupTick.deadlineUs - rollupOriginUs + 500000) / 1000000) + !awake;
+            Rollup_record(&rollups, second, (uint32_t)(sample - rollupLast));
+            // the activity LED stays dark while keys are lost
+            uint32_t rate = (uint32_t)(sample - rollupLast);
+            if (!rate || Counter_read(&lastLost))
+                LedEngine_clear(&ledEngine, LedSignal_Activity);
+            else
+                LedEngine_raise(&ledEngine, LedSignal_Activity, LedEngine_dutyForRate(rate, ACTIVITY_RATE_FULL));
+            rollupLast = sample;
+            if (!awake)
+                break;
+        }
+        sampleSeconds = (monotonicMs() - sleptFromMs) / 1000.0;
+        if (sampleSeconds < 0.001)
+            sampleSeconds = 0.001;
     }
 
+#if !RESP3_MUX
+    if (threadConn > 0)
+        closeConnection(tArgs, threadConn);
+#endif
     printf("watch thread exiting.\n");
-    --threadRunningCount;
+    Startup_stopped(&startup, StartupPhase_Watch);
 }
 
 void* psubThreadFunc(void* arg)
 {
     assert(arg);
     psubThreadArgs_t* tArgs = (psubThreadArgs_t*)arg;
-    RedisConnection_t threadConn = newConnection(tArgs);
+    RedisConnection_t threadConn = newConnection(tArgs, ReconnectLink_Activity);
+
+    char pattern[CONFIG_PATTERN_LEN];
+    uint64_t configGeneration = Config_generation();
+    strcpy(pattern, Config_enter(ConfigReader_Activity)->subscribePattern);
+    Config_exit(ConfigReader_Activity);
 
-    Redis_PSUBSCRIBE(threadConn, "*");
+    Redis_PSUBSCRIBE(threadConn, pattern);
+    activityConn = threadConn;
+    Shutdown_track(threadConn);
     printf("activity thread up and running.\n");
-    threadRunningCount++;
+    Startup_ready(&startup, StartupPhase_Activity);
 
-    while (running)
+    while (running && threadConn > 0)
     {
         RedisObject_t nextObj = RedisConnection_getNextObject(threadConn);
+        bool dropped = nextObj.type == RedisObjectType_Invalid;
+#if ACTIVITY_LATENCY_PROBE
+        // pmessage, pattern, channel, payload
+        RedisArray_t* arr = nextObj.type == RedisObjectType_Array ? (RedisArray_t*)nextObj.obj : NULL;
+        if (arr && arr->count == 4 && arr->objects[3].type == RedisObjectType_BulkString && arr->objects[3].obj)
+            LatHist_recordPayload(&activityLatency, (const char*)arr->objects[3].obj);
+#endif
         RedisObject_dealloc(nextObj);
 
-        if (!lastLost)
+        if (dropped)
         {
-            struct timespec quickTime = { 0, 1 };
-            GPIO_SetValue(tArgs->fds[GREEN_FDIDX], LED_ON);
-            nanosleep(&quickTime, NULL);
-            GPIO_SetValue(tArgs->fds[GREEN_FDIDX], LED_OFF);
+            // resubscribe with whatever pattern is current by the time we're back
+            if (!running)
+                break;
+            fprintf(stderr, "activity connection lost, reconnecting\n");
+            activityConn = -1;
+            Shutdown_untrack(threadConn);
+            closeConnection(tArgs, threadConn);
+            Reconnect_lost(ReconnectLink_Activity);
+            if ((threadConn = newConnection(tArgs, ReconnectLink_Activity)) < 1)
+                break;
+            Shutdown_track(threadConn);
+
+            configGeneration = Config_generation();
+            strcpy(pattern, Config_enter(ConfigReader_Activity)->subscribePattern);
+            Config_exit(ConfigReader_Activity);
+            Redis_PSUBSCRIBE(threadConn, pattern);
+            activityConn = threadConn;
+            continue;
+        }
+
+        if (Config_generation() != configGeneration)
+        {
+            char oldPattern[CONFIG_PATTERN_LEN];
+            strcpy(oldPattern, pattern);
+            configGeneration = Config_generation();
+            strcpy(pattern, Config_enter(ConfigReader_Activity)->subscribePattern);
+            Config_exit(ConfigReader_Activity);
+
+            // the confirmations come back through getNextObject like any message
+            if (strcmp(oldPattern, pattern))
+            {
+                const char* unsub[] = { "PUNSUBSCRIBE", oldPattern };
+                const char* sub[] = { "PSUBSCRIBE", pattern };
+                if (!Resp_sendCommand(threadConn, 2, unsub, NULL) || !Resp_sendCommand(threadConn, 2, sub, NULL))
+                    fprintf(stderr, "activity resubscribe to '%s' failed\n", pattern);
+                else
+                    printf("activity thread resubscribed to '%s'\n", pattern);
+            }
         }
 
-        ++msgCount;
+        Counter_add(&msgCount, 1);
     }
 
+    if (threadConn > 0)
+    {
+        activityConn = -1;
+        Shutdown_untrack(threadConn);
+        closeConnection(tArgs, threadConn);
+    }
     printf("activity thread exiting.\n");
-    --threadRunningCount;
+    Startup_stopped(&startup, StartupPhase_Activity);
+}
+
+// hands a command from either subscription to the workers
+static void queueCommand(const char* cmdStr)
+{
+    switch (CmdQueue_push(&cmdQueue, cmdStr))
+    {
+    case CmdQueuePush_Full:
+        fprintf(stderr, "command queue full, dropped '%s'\n", cmdStr);
+        break;
+    case CmdQueuePush_TooLong:
+        fprintf(stderr, "command longer than %d chars, dropped '%.32s...'\n", COMMAND_MAX_LEN - 1, cmdStr);
+        break;
+    default:
+        break;
+    }
+}
+
+#if RESP3_MUX
+static pthread_mutex_t muxPatternLock = PTHREAD_MUTEX_INITIALIZER;
+static char muxPattern[CONFIG_PATTERN_LEN];
+
+// moves the mux's activity subscription to the configured pattern; the
+// confirmations arrive as pushes, which onMuxPush ignores
+static bool muxResubscribe(void)
+{
+    pthread_mutex_lock(&muxPatternLock);
+    char pattern[CONFIG_PATTERN_LEN];
+    strcpy(pattern, Config_enter(ConfigReader_Activity)->subscribePattern);
+    Config_exit(ConfigReader_Activity);
+
+    bool ok = true;
+    if (strcmp(muxPattern, pattern))
+    {
+        const char* unsub[] = { "PUNSUBSCRIBE", muxPattern };
+        const char* sub[] = { "PSUBSCRIBE", pattern };
+        ok = (!*muxPattern || Mux_send(&mux, 2, unsub)) && Mux_send(&mux, 2, sub);
+        if (ok)
+            strcpy(muxPattern, pattern);
+    }
+    pthread_mutex_unlock(&muxPatternLock);
+    return ok;
+}
+
+static bool muxSetAndPublish(const char* key, const char* value)
+{
+    const char* set[] = { "SET", key, value };
+    const char* pub[] = { "PUBLISH", key, value };
+    size_t need = 2 * (strlen(key) + strlen(value) + 64);
+    char* buf = (char*)malloc(need);
+    if (!buf)
+        return false;
+
+    size_t len = Resp_encodeCommand(buf, need, 3, set, NULL);
+    size_t pubLen = len ? Resp_encodeCommand(buf + len, need - len, 3, pub, NULL) : 0;
+    bool ok = pubLen && Mux_transport(&mux, buf, len + pubLen, 2);
+    free(buf);
+    return ok;
+}
+
+// runs on the mux reader thread: does what the activity and command
+// threads do with their subscriptions in RESP2 mode
+static void onMuxPush(const Resp3Value_t* push, void* ctx)
+{
+    if (push->count < 3 || !push->items[0].str)
+        return;
+
+    const char* kind = push->items[0].str;
+    if (!strcmp(kind, "message") && push->count == 3 && push->items[2].str)
+    {
+        queueCommand(push->items[2].str);
+    }
+    else if (!strcmp(kind, "pmessage"))
+    {
+#if ACTIVITY_LATENCY_PROBE
+        if (push->count == 4 && push->items[3].str)
+            LatHist_recordPayload(&activityLatency, push->items[3].str);
+#endif
+        Counter_add(&msgCount, 1);
+    }
+}
+
+// connects and runs the RESP3 handshake, and in sentinel mode confirms the
+// primary; from here on the socket belongs to the mux
+static RedisConnection_t connectMux(void* ctx)
+{
+    psubThreadArgs_t* tArgs = (psubThreadArgs_t*)ctx;
+    SentinelAddr_t endpoint;
+    redisEndpoint(tArgs, &endpoint);
+    RedisConnection_t conn = RedisConnect(endpoint.host, endpoint.port);
+    if (conn < 1)
+    {
+        fprintf(stderr, "RedisConnect failed: %d\n", conn);
+        fflush(stderr);
+        return conn;
+    }
+
+    applySocketProfile(conn, SocketRole_Subscriber);
+    if (!Mux_start(&mux, conn, tArgs->pass))
+        return -3;
+
+    if (tArgs->sentinel)
+    {
+        const char* roleArgs[] = { "ROLE" };
+        Resp3Value_t role;
+        bool primary = false;
+        if (Mux_call(&mux, 1, roleArgs, &role))
+        {
+            const char* name = Resp3_itemString(&role, 0);
+            primary = name && !strcmp(name, "master");
+            Resp3_free(&role);
+        }
+        if (!primary)
+        {
+            fprintf(stderr, "%s:%s is not the primary, asking the sentinels again\n", endpoint.host, endpoint.port);
+            Mux_stop(&mux);
+            Sentinel_discover(tArgs->sentinel);
+            return -4;
+        }
+        Sentinel_track(tArgs->sentinel, conn);
+    }
+    return conn;
+}
+
+// owns the mux's connection: (re)connects with backoff, resubscribes, and
+// waits for it to drop. Everyone else just fails fast while it's down.
+static void* muxThreadFunc(void* arg)
+{
+    psubThreadArgs_t* tArgs = (psubThreadArgs_t*)arg;
+    const char* cmdSub[] = { "SUBSCRIBE", "spheremon:command" };
+
+    while (running)
+    {
+        RedisConnection_t conn = Reconnect_until(ReconnectLink_Mux, connectMux, tArgs, &running);
+        if (conn < 1)
+            break;
+
+        // a fresh connection has no subscriptions
+        pthread_mutex_lock(&muxPatternLock);
+        muxPattern[0] = '\0';
+        pthread_mutex_unlock(&muxPatternLock);
+
+        if (muxResubscribe() && Mux_send(&mux, 2, cmdSub))
+        {
+            printf("multiplexed RESP3 connection up.\n");
+            // the mux carries what the activity and command threads would have
+            Startup_ready(&startup, StartupPhase_Activity);
+            Startup_ready(&startup, StartupPhase_Command);
+
+            // main shuts the socket down once the watch thread is done with it
+            if (running)
+                Mux_wait(&mux);
+        }
+        else
+        {
+            fprintf(stderr, "RESP3 subscribe failed\n");
+        }
+
+        if (tArgs->sentinel)
+            Sentinel_untrack(tArgs->sentinel, conn);
+        Mux_stop(&mux);
+        if (running)
+        {
+            fprintf(stderr, "multiplexed connection lost, reconnecting\n");
+            Reconnect_lost(ReconnectLink_Mux);
+        }
+    }
+
+    printf("mux thread exiting.\n");
+    Startup_stopped(&startup, StartupPhase_Activity);
+    Startup_stopped(&startup, StartupPhase_Command);
+    return NULL;
+}
+#endif
+
+bool cmdMessageCount(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    snprintf(reply, replyLen, "%lld", (long long)Counter_read(&msgCount));
+    return true;
+}
+
+bool cmdTrackedKeys(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    snprintf(reply, replyLen, "%d/%d", trackedKeyCount - (int)Counter_read(&lastLost), trackedKeyCount);
+    return true;
+}
+
+bool cmdRollup(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    // e.g. "rollup 1m 45 35": each minute from 45 to 35 minutes ago
+    unsigned long toAgo = args->argc > 3 ? args->num[3] : 0;
+    if (Rollup_query(&rollups, Rollup_parseResolution(args->argv[1]), (uint32_t)args->num[2], (uint32_t)toAgo,
+        reply, replyLen) < 0)
+        snprintf(reply, replyLen, "bad range (1s|1m|1h, from-ago >= to-ago, max %d buckets)", ROLLUP_QUERY_MAX_BUCKETS);
+    return true;
+}
+
+static bool setCadence(Config_t* next, const void* ctx)
+{
+    next->keyCheckCadenceSeconds = *(const uint32_t*)ctx;
+    return true;
+}
+
+static bool setWatchInterval(Config_t* next, const void* ctx)
+{
+    next->watchIntervalSeconds = *(const uint32_t*)ctx;
+    return true;
+}
+
+static bool addPattern(Config_t* next, const void* ctx)
+{
+    if (next->keyPatternCount == CONFIG_MAX_PATTERNS)
+        return false;
+    for (size_t i = 0; i < next->keyPatternCount; i++)
+        if (!strcmp(next->keyPatterns[i], (const char*)ctx))
+            return false;
+
+    strcpy(next->keyPatterns[next->keyPatternCount++], (const char*)ctx);
+    next->keysGeneration++;
+    return true;
+}
+
+static bool removePattern(Config_t* next, const void* ctx)
+{
+    for (size_t i = 0; i < next->keyPatternCount; i++)
+    {
+        if (!strcmp(next->keyPatterns[i], (const char*)ctx))
+        {
+            memmove(next->keyPatterns[i], next->keyPatterns[i + 1],
+                (next->keyPatternCount - i - 1) * CONFIG_PATTERN_LEN);
+            next->keyPatternCount--;
+            next->keysGeneration++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool setSubscribePattern(Config_t* next, const void* ctx)
+{
+    strcpy(next->subscribePattern, (const char*)ctx);
+    return true;
+}
+
+static bool reloadKeys(Config_t* next, const void* ctx)
+{
+    next->keysGeneration++;
+    return true;
+}
+
+static bool replyConfigUpdate(bool ok, const char* failure, char* reply, size_t replyLen)
+{
+    if (ok)
+        snprintf(reply, replyLen, "ok (config generation %llu)", (unsigned long long)Config_generation());
+    else
+        snprintf(reply, replyLen, "%s", failure);
+    return true;
+}
+
+#define MAX_CONFIG_SECONDS 3600
+
+bool cmdSetCadence(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    uint32_t seconds = (uint32_t)args->num[1];
+    return replyConfigUpdate(seconds && seconds <= MAX_CONFIG_SECONDS && Config_update(setCadence, &seconds),
+        "cadence must be 1-3600 seconds", reply, replyLen);
+}
+
+bool cmdSetWatchInterval(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    uint32_t seconds = (uint32_t)args->num[1];
+    return replyConfigUpdate(seconds && seconds <= MAX_CONFIG_SECONDS && Config_update(setWatchInterval, &seconds),
+        "interval must be 1-3600 seconds", reply, replyLen);
+}
+
+bool cmdAddPattern(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    return replyConfigUpdate(strlen(args->argv[1]) < CONFIG_PATTERN_LEN && Config_update(addPattern, args->argv[1]),
+        "pattern too long, already present, or pattern table full", reply, replyLen);
+}
+
+bool cmdRemovePattern(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    return replyConfigUpdate(Config_update(removePattern, args->argv[1]), "no such pattern", reply, replyLen);
+}
+
+bool cmdResubscribe(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    if (strlen(args->argv[1]) >= CONFIG_PATTERN_LEN || !Config_update(setSubscribePattern, args->argv[1]))
+        return replyConfigUpdate(false, "pattern too long", reply, replyLen);
+
+#if RESP3_MUX
+    return replyConfigUpdate(muxResubscribe(), "resubscribe failed", reply, replyLen);
+#else
+    // the activity thread only looks at the config between messages, so
+    // nudge it with a PING (allowed in subscribe mode) in case traffic is quiet
+    RedisConnection_t conn = activityConn;
+    const char* ping[] = { "PING" };
+    if (conn > 0)
+        Resp_sendCommand(conn, 1, ping, NULL);
+    return replyConfigUpdate(true, NULL, reply, replyLen);
+#endif
+}
+
+bool cmdReloadKeys(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    return replyConfigUpdate(Config_update(reloadKeys, NULL), "reload failed", reply, replyLen);
+}
+
+bool cmdShowConfig(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    Config_t cfg;
+    Config_copy(&cfg);
+    int off = snprintf(reply, replyLen, "generation=%llu cadence=%us watch-interval=%us subscribe='%s' patterns=",
+        (unsigned long long)cfg.generation, cfg.keyCheckCadenceSeconds, cfg.watchIntervalSeconds, cfg.subscribePattern);
+    for (size_t i = 0; i < cfg.keyPatternCount && off > 0 && (size_t)off < replyLen; i++)
+        off += snprintf(reply + off, replyLen - off, "%s'%s'", i ? "," : "", cfg.keyPatterns[i]);
+    return true;
+}
+
+#define LOST_KEYS_DEFAULT_LIMIT 50
+#define LOST_KEYS_MAX_LIMIT 500
+
+bool cmdLostKeys(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    // lost-keys [cursor] [limit]: "<lost> <next-cursor> names...", next-cursor 0 when done
+    size_t cursor = args->argc > 1 ? args->num[1] : 0;
+    size_t limit = args->argc > 2 ? args->num[2] : LOST_KEYS_DEFAULT_LIMIT;
+    KeyTable_formatLost(&keyTable, cursor, limit && limit <= LOST_KEYS_MAX_LIMIT ? limit : LOST_KEYS_MAX_LIMIT,
+        reply, replyLen);
+    return true;
+}
+
+bool cmdConnectStats(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    if (!Connect_formatStats(reply, replyLen))
+        snprintf(reply, replyLen, "no connects yet");
+    return true;
+}
+
+bool cmdReconnects(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    Reconnect_formatStats(reply, replyLen);
+    return true;
+}
+
+typedef struct SocketProfileUpdate
+{
+    SocketRole_t role;
+    const char* field;
+    uint32_t value;
+} SocketProfileUpdate_t;
+
+static bool setSocketProfileField(Config_t* next, const void* ctx)
+{
+    const SocketProfileUpdate_t* update = (const SocketProfileUpdate_t*)ctx;
+    return SocketProfile_set(&next->socketProfiles[update->role], update->field, update->value);
+}
+
+bool cmdSocketProfile(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    // socket-profile <role> [field value]: applies from each role's next connect
+    SocketProfileUpdate_t update = { .field = args->argc > 2 ? args->argv[2] : NULL };
+    if (!SocketProfile_parseRole(args->argv[1], &update.role))
+    {
+        snprintf(reply, replyLen, "unknown role (subscriber, sweep, command, reply)");
+        return true;
+    }
+
+    if (update.field)
+    {
+        if (args->argc < 4)
+            return replyConfigUpdate(false, "missing value", reply, replyLen);
+        update.value = (uint32_t)args->num[3];
+        if (!Config_update(setSocketProfileField, &update))
+            return replyConfigUpdate(false, "unknown field", reply, replyLen);
+    }
+
+    Config_t cfg;
+    Config_copy(&cfg);
+    SocketProfile_format(&cfg.socketProfiles[update.role], reply, replyLen);
+    return true;
+}
+
+bool cmdTargets(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    if (!TargetSet_format(&targets, reply, replyLen))
+        snprintf(reply, replyLen, "no extra targets");
+    return true;
+}
+
+bool cmdTargetLostKeys(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    // target-lost-keys <name> [cursor] [limit]: as lost-keys, for one extra target
+    Target_t* target = TargetSet_find(&targets, args->argv[1]);
+    if (!target)
+    {
+        snprintf(reply, replyLen, "no such target");
+        return true;
+    }
+
+    size_t cursor = args->argc > 2 ? args->num[2] : 0;
+    size_t limit = args->argc > 3 ? args->num[3] : LOST_KEYS_DEFAULT_LIMIT;
+    KeyTable_formatLost(&target->keys, cursor, limit && limit <= LOST_KEYS_MAX_LIMIT ? limit : LOST_KEYS_MAX_LIMIT,
+        reply, replyLen);
+    return true;
+}
+
+bool cmdLedPatterns(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    LedEngine_format(&ledEngine, reply, replyLen);
+    return true;
+}
+
+bool cmdLedStats(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    Led_formatStats(&ledBank, reply, replyLen);
+    return true;
+}
+
+bool cmdActivityLatency(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+#if ACTIVITY_LATENCY_PROBE
+    if (args->argc > 1 && strcmp(args->argv[1], "reset"))
+    {
+        snprintf(reply, replyLen, "expected 'reset'");
+        return true;
+    }
+    LatHist_format(&activityLatency, reply, replyLen);
+    if (args->argc > 1)
+        LatHist_reset(&activityLatency);
+#else
+    snprintf(reply, replyLen, "built without ACTIVITY_LATENCY_PROBE");
+#endif
+    return true;
+}
+
+bool cmdSweepStats(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    Schedule_format(&sweepSchedule, reply, replyLen);
+    return true;
+}
+
+bool cmdCommandStats(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    if (args->argc > 1)
+    {
+        Command_formatStats(args->argv[1], reply, replyLen);
+        return true;
+    }
+
+    size_t off = CmdQueue_format(&cmdQueue, reply, replyLen);
+    if (off + 2 < replyLen)
+    {
+        memcpy(reply + off, "; ", 3);
+        Command_formatStats(NULL, reply + off + 2, replyLen - off - 2);
+    }
+    return true;
+}
+
+bool cmdStartup(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    Startup_format(&startup, reply, replyLen);
+    return true;
+}
+
+bool cmdKill(const CommandArgs_t* args, char* reply, size_t replyLen)
+{
+    printf("Kill command! Shutting down...\n");
+    fflush(stdout);
+    Shutdown_request();
+    return false;
+}
+
+void* cmdWorkerFunc(void* arg)
+{
+    assert(arg);
+#if !RESP3_MUX
+    psubThreadArgs_t* tArgs = (psubThreadArgs_t*)arg;
+
+    // can't reply on the command thread's connection because it's in the "subscribe" modality
+    ReplyConnection_t replyConn;
+    ReplyConnection_init(&replyConn, connectReply, closeConnection, tArgs);
+#endif
+
+    CmdQueueJob_t job;
+    while (CmdQueue_pop(&cmdQueue, &job))
+    {
+        char sBuf[COMMAND_REPLY_SIZE];
+        bzero(sBuf, COMMAND_REPLY_SIZE);
+        char* cmdStr = job.cmd;
+        CommandResult_t res = Command_dispatchQueued(cmdStr, Command_monotonicUs() - job.enqueuedUs, sBuf, COMMAND_REPLY_SIZE);
+        bool sBufHasResp = res == CommandResult_Reply || res == CommandResult_BadArgs;
+
+        if (sBufHasResp)
+        {
+            int chanNameLen = strlen("spheremon:command:result:") + strlen(cmdStr) + 1;
+            char* chanName = (char*)malloc(chanNameLen);
+            bzero(chanName, chanNameLen);
+            snprintf(chanName, chanNameLen, "spheremon:command:result:%s", cmdStr);
+
+#if RESP3_MUX
+            if (!muxSetAndPublish(chanName, sBuf))
+#else
+            if (!ReplyConnection_setAndPublish(&replyConn, chanName, sBuf))
+#endif
+                fprintf(stderr, "failed to set %s\n", chanName);
+
+            free(chanName);
+
+            printf("Command '%s' respone: '%s'\n", cmdStr, sBuf);
+            fflush(stdout);
+        }
+    }
+
+#if !RESP3_MUX
+    ReplyConnection_close(&replyConn);
+#endif
+    return NULL;
 }
 
 void* cmdThreadFunc(void* arg)
 {
     assert(arg);
     psubThreadArgs_t* tArgs = (psubThreadArgs_t*)arg;
-    RedisConnection_t threadConn = newConnection(tArgs);
+    RedisConnection_t threadConn = newConnection(tArgs, ReconnectLink_Command);
 
     Redis_SUBSCRIBE(threadConn, "spheremon:command");
+    Shutdown_track(threadConn);
     printf("command thread up and running.\n");
-    threadRunningCount++;
+    Startup_ready(&startup, StartupPhase_Command);
 
-    while (running)
+    // only parse and hand off here; the workers run handlers and reply
+    while (running && threadConn > 0)
     {
         RedisObject_t nextObj = RedisConnection_getNextObject(threadConn);
 
-        if (nextObj.type == RedisObjectType_Array && nextObj.obj)
+        if (nextObj.type == RedisObjectType_Invalid && running)
+        {
+            fprintf(stderr, "command connection lost, reconnecting\n");
+            Shutdown_untrack(threadConn);
+            closeConnection(tArgs, threadConn);
+            Reconnect_lost(ReconnectLink_Command);
+            if ((threadConn = newConnection(tArgs, ReconnectLink_Command)) > 0)
+            {
+                Redis_SUBSCRIBE(threadConn, "spheremon:command");
+                Shutdown_track(threadConn);
+            }
+        }
+        else if (nextObj.type == RedisObjectType_Array && nextObj.obj)
         {
             RedisArray_t* arr = (RedisArray_t*)nextObj.obj;
             if (arr->count == 3 && arr->objects[2].type == RedisObjectType_BulkString && arr->objects[2].obj)
             {
-                char sBuf[64];
-                bzero(sBuf, 64);
-                char* cmdStr = (char*)arr->objects[2].obj;
-                bool sBufHasResp = true;
-
-                if (!strncmp("message-count", cmdStr, strlen("message-count")))
-                    snprintf(sBuf, 64, "%d", msgCount);
-                else if (!strncmp("tracked-keys", cmdStr, strlen("tracked-keys")))
-                    snprintf(sBuf, 64, "%d/%d", trackedKeyCount - lastLost, trackedKeyCount);
-                else if (!strncmp("killkillkill", cmdStr, strlen("killkillkill")))
-                {
-                    printf("Kill command! Shutting down...\n");
-                    fflush(stdout);
-                    running = false;
-                    sBufHasResp = false;
-                }
-                else
-                    sBufHasResp = false;
-
-                if (sBufHasResp)
-                {
-                    int chanNameLen = strlen("spheremon:command:result:") + strlen(cmdStr) + 1;
-                    char* chanName = (char*)malloc(chanNameLen);
-                    bzero(chanName, chanNameLen);
-                    snprintf(chanName, chanNameLen, "spheremon:command:result:%s", cmdStr);
-
-                    // can't use threadConn because it's in the "subscribe" modality
-                    RedisConnection_t tempConn = newConnection(tArgs);
-                    if (!Redis_SET(tempConn, chanName, sBuf))
-                        fprintf(stderr, "failed to set %s\n", chanName);
-                    Redis_PUBLISH(tempConn, chanName, sBuf);
-
-                    close(tempConn);
-                    free(chanName);
-
-                    printf("Command '%s' respone: '%s'\n", cmdStr, sBuf);
-                    fflush(stdout);
-                }
+                queueCommand((const char*)arr->objects[2].obj);
             }
         }
 
         RedisObject_dealloc(nextObj);
     }
 
+    if (threadConn > 0)
+    {
+        Shutdown_untrack(threadConn);
+        closeConnection(tArgs, threadConn);
+    }
     printf("command thread exiting.\n");
-    --threadRunningCount;
+    Startup_stopped(&startup, StartupPhase_Command);
+}
+
+void* cmdStreamThreadFunc(void* arg)
+{
+    assert(arg);
+    printf("command stream thread up and running.\n");
+
+    CmdStream_threadFunc(arg);
+
+    printf("command stream thread exiting.\n");
+    Startup_stopped(&startup, StartupPhase_CommandStream);
+    return NULL;
+}
+
+static void cmdStreamConnected(void* ctx)
+{
+    Startup_ready(&startup, StartupPhase_CommandStream);
 }
 
 void sighand(int sig)
@@ -326,50 +1242,104 @@ void sighand(int sig)
     if (sig == SIGTERM)
     {
         printf("Got SIGTERM! Shutting down...\n");
-        running = false;
+        Shutdown_request();
     }
 }
 
 int main(int argc, char** argv)
 {
+    Startup_init(&startup);
+    if (!Shutdown_init(&running))
+    {
+        perror("eventfd");
+        exit(-errno);
+    }
     signal(SIGTERM, sighand);
 
     if (argc < 3)
     {
-        fprintf(stderr, "Usage: %s host port password\n\n", argv[0]);
+        fprintf(stderr, "Usage: %s host port [password] [device-id] [target...]\n"
+            "       %s " SENTINEL_PREFIX "<master-name> sentinel:port[,sentinel:port...] [password] [device-id] [target...]\n"
+            "where each target is name=[password@]host:port[;subscribe-pattern[;key-pattern...]]\n\n",
+            argv[0], argv[0]);
         exit(-1);
     }
 
     const char* host = argv[1];
     const char* port = argv[2];
     const char* pass = argc > 3 ? argv[3] : NULL;
+    const char* deviceId = argc > 4 && *argv[4] ? argv[4] : "spheremon";
 
-    printf("Running GPIO setup for LEDs...\n");
-    int* fds = setupLEDs();
+    static Sentinel_t sentinel;
+    bool sentinelMode = Sentinel_isSpec(host);
+    if (sentinelMode && !Sentinel_init(&sentinel, host, port, &running))
+    {
+        fprintf(stderr, "Bad sentinel spec '%s' '%s'\n\n", host, port);
+        exit(-1);
+    }
 
-    if (!fds)
+    Config_t initialConfig = {
+        .keyCheckCadenceSeconds = KEY_CHECK_CADENCE_SECONDS,
+        .watchIntervalSeconds = WATCH_INTERVAL_SECONDS,
+        .subscribePattern = SUBSCRIBE_PATTERN,
+        .keyPatternCount = 2,
+        .keyPatterns = { "rpjios.checkin.*", "*:heartbeat" },
+        .socketProfiles = SOCKET_PROFILE_DEFAULTS
+    };
+    Config_init(&initialConfig);
+
+    TargetSet_init(&targets, &running);
+    for (int i = 5; i < argc; i++)
     {
-        fprintf(stderr, "LED setup failed\n\n");
+        if (!TargetSet_add(&targets, argv[i], &initialConfig))
+        {
+            fprintf(stderr, "Bad or duplicate target '%s' (at most %d)\n\n", argv[i], TARGET_MAX);
+            exit(-1);
+        }
+    }
+
+    if (!Command_verifyTable())
+    {
+        fprintf(stderr, "commandhash.h is stale; regenerate it from commands.def\n\n");
         exit(-1);
     }
 
-    TOGGLE_ALL(fds, LED_OFF);
+    if (!LedEngine_init(&ledEngine, ledPatterns, LedSignal_Count))
+    {
+        fprintf(stderr, "LED engine init failed\n\n");
+        exit(-1);
+    }
+    LedEngine_raise(&ledEngine, LedSignal_NetworkWait, 0);
 
-    printf("Verifying network availability...\n");
-    GPIO_SetValue(fds[BLUE_FDIDX], LED_ON);
+    printf("Running GPIO setup for LEDs...\n");
+    pthread_t gpioThread;
+    int pc = pthread_create(&gpioThread, NULL, gpioSetupFunc, NULL);
 
-    const struct timespec sleepTime = { 1, 0 };
+    if (pc)
+    {
+        fprintf(stderr, "pthread_create (gpio): %d\n", pc);
+        exit(pc);
+    }
+
+    printf("Verifying network availability...\n");
     static int netCheckRetries = WAIT_FOR_WIFI_SECONDS;
     while (!netCheck() && --netCheckRetries)
     {
-        const struct timespec quickTime = { 0, 5e7 };
-        GPIO_SetValue(fds[RED_FDIDX], LED_ON);
-        nanosleep(&quickTime, NULL);
-        GPIO_SetValue(fds[RED_FDIDX], LED_OFF);
-        nanosleep(&sleepTime, NULL);
+        LedEngine_raise(&ledEngine, LedSignal_NetworkRetry, 0);
+        if (!Shutdown_sleep(1000))
+            break;
     }
+    LedEngine_clear(&ledEngine, LedSignal_NetworkRetry);
+    if (Shutdown_requested())
+        exit(0);
 
-    GPIO_SetValue(fds[BLUE_FDIDX], LED_OFF);
+    pthread_join(gpioThread, NULL);
+
+    if (!Startup_isReady(&startup, StartupPhase_Gpio))
+    {
+        fprintf(stderr, "LED setup failed\n\n");
+        exit(-1);
+    }
 
     if (!netCheckRetries)
     {
@@ -377,53 +1347,118 @@ int main(int argc, char** argv)
         exit(-errno);
     }
 
+    Startup_ready(&startup, StartupPhase_Network);
     if (netCheckRetries != WAIT_FOR_WIFI_SECONDS)
     {
         printf("... waited %d seconds for network.\n", WAIT_FOR_WIFI_SECONDS - netCheckRetries);
     }
 
-    printf("Connecting to redis://%s%s:%s...\n", pass ? "*@" : "", host, port);
-    GPIO_SetValue(fds[GREEN_FDIDX], LED_ON);
+    // resolved once up front so the threads' first connects are cache hits
+    // instead of racing each other to the same lookup
+    size_t endpoints = 0, resolved = 0;
+    if (sentinelMode)
+        for (size_t i = 0; i < sentinel.sentinelCount; i++, endpoints++)
+            resolved += Connect_prefetch(sentinel.sentinels[i].host, sentinel.sentinels[i].port) > 0;
+    else
+    {
+        endpoints++;
+        resolved += Connect_prefetch(host, port) > 0;
+    }
+    for (size_t i = 0; i < targets.count; i++, endpoints++)
+        resolved += Connect_prefetch(targets.targets[i].host, targets.targets[i].port) > 0;
+
+    if (resolved == endpoints)
+        Startup_ready(&startup, StartupPhase_Dns);
+    else
+    {
+        Startup_fail(&startup, StartupPhase_Dns);
+        fprintf(stderr, "Resolved %zu of %zu endpoints; the rest retry on connect\n", resolved, endpoints);
+    }
+
+    if (sentinelMode)
+    {
+        printf("Asking sentinels %s for '%s'...\n", port, sentinel.masterName);
+        if (!Sentinel_start(&sentinel))
+        {
+            fprintf(stderr, "Failed to start sentinel watcher\n");
+            exit(-1);
+        }
+    }
+    else
+        printf("Connecting to redis://%s%s:%s...\n", pass ? "*@" : "", host, port);
+    LedEngine_clear(&ledEngine, LedSignal_NetworkWait);
+    LedEngine_raise(&ledEngine, LedSignal_Connecting, 0);
 
     psubThreadArgs_t psubThreadArgs = {
-        .fds = fds,
         .host = host,
         .port = port,
-        .pass = pass
+        .pass = pass,
+        .sentinel = sentinelMode ? &sentinel : NULL
     };
 
-    RedisConnection_t rConn = newConnection(&psubThreadArgs);
+    KeyTable_init(&keyTable);
 
-    printf("Querying expected key sets...\n");
-    RedisArray_t *rpjiosKeys = Redis_KEYS(rConn, "rpjios.checkin.*");
-    RedisArray_t *zerowatchKeys = Redis_KEYS(rConn, "*:heartbeat");
-
-    if (!rpjiosKeys || !zerowatchKeys)
+    if (!Rollup_init(&rollups, ROLLUP_1S_SLOTS, ROLLUP_1M_SLOTS, ROLLUP_1H_SLOTS))
     {
-        fprintf(stderr, "Failed to query key sets we expected\n");
-        exit(-2);
+        fprintf(stderr, "Failed to allocate rollup store\n");
+        exit(-3);
     }
 
-    const struct timespec loopTime = { KEY_CHECK_CADENCE_SECONDS, 0 };
-    const struct timespec blinkTime = { 0, 5e8 };
-
-    printf("Found %d rpjios and %d zerowatch keys to monitor every %ds\n",
-        rpjiosKeys->count, zerowatchKeys->count, loopTime.tv_sec);
-    trackedKeyCount = rpjiosKeys->count + zerowatchKeys->count;
+    printf("Rollups: %d/%d/%d 1s/1m/1h buckets in %zu bytes\n",
+        ROLLUP_1S_SLOTS, ROLLUP_1M_SLOTS, ROLLUP_1H_SLOTS,
+        ROLLUP_MEMORY_BYTES(ROLLUP_1S_SLOTS, ROLLUP_1M_SLOTS, ROLLUP_1H_SLOTS));
 
+#if RESP3_MUX
+    pthread_t muxThread;
+#else
     pthread_t psubThread;
     pthread_t commandThread;
+#endif
+    pthread_t cmdWorkers[CMD_WORKER_COUNT];
     pthread_t watchThread;
+    pthread_t cmdStreamThread;
+    pthread_t targetActivityThread;
+    pthread_t targetSweepThread;
 
+#if !RESP3_MUX
     printf("Starting activity thread...\n");
-    int pc = pthread_create(&psubThread, NULL, psubThreadFunc, &psubThreadArgs);
+    pc = pthread_create(&psubThread, NULL, psubThreadFunc, &psubThreadArgs);
 
     if (pc)
     {
         fprintf(stderr, "pthread_create (activity): %d\n", pc);
         exit(pc);
     }
+#endif
+
+#if RESP3_MUX
+    // dead until the mux thread connects; workers may call into it before then
+    Mux_init(&mux, onMuxPush, &psubThreadArgs);
+#endif
+
+    printf("Starting %d command workers...\n", CMD_WORKER_COUNT);
+    CmdQueue_init(&cmdQueue);
+    for (int i = 0; i < CMD_WORKER_COUNT; i++)
+    {
+        pc = pthread_create(&cmdWorkers[i], NULL, cmdWorkerFunc, &psubThreadArgs);
+
+        if (pc)
+        {
+            fprintf(stderr, "pthread_create (command worker %d): %d\n", i, pc);
+            exit(pc);
+        }
+    }
 
+#if RESP3_MUX
+    printf("Starting multiplexed RESP3 connection thread...\n");
+    pc = pthread_create(&muxThread, NULL, muxThreadFunc, &psubThreadArgs);
+
+    if (pc)
+    {
+        fprintf(stderr, "pthread_create (mux): %d\n", pc);
+        exit(pc);
+    }
+#else
     printf("Starting command thread...\n");
     pc = pthread_create(&commandThread, NULL, cmdThreadFunc, &psubThreadArgs);
 
@@ -432,6 +1467,7 @@ int main(int argc, char** argv)
         fprintf(stderr, "pthread_create (command): %d\n", pc);
         exit(pc);
     }
+#endif
 
     printf("Starting watch thread...\n");
     pc = pthread_create(&watchThread, NULL, watchThreadFunc, &psubThreadArgs);
@@ -442,13 +1478,62 @@ int main(int argc, char** argv)
         exit(pc);
     }
 
-    GPIO_SetValue(fds[BLUE_FDIDX], LED_OFF);
-    while (threadRunningCount < 3);
+    CmdStreamArgs_t cmdStreamArgs = {
+        .connect = connectCommand,
+        .disconnect = closeConnection,
+        .ctx = &psubThreadArgs,
+        .deviceId = deviceId,
+        .running = &running,
+        .onConnected = cmdStreamConnected
+    };
+
+    printf("Starting command stream thread (consumer group '%s')...\n", deviceId);
+    pc = pthread_create(&cmdStreamThread, NULL, cmdStreamThreadFunc, &cmdStreamArgs);
+
+    if (pc)
+    {
+        fprintf(stderr, "pthread_create (command stream): %d\n", pc);
+        exit(pc);
+    }
+
+    if (targets.count)
+    {
+        printf("Starting activity and sweep threads for %zu extra targets...\n", targets.count);
+        if ((pc = pthread_create(&targetActivityThread, NULL, TargetSet_activityFunc, &targets))
+            || (pc = pthread_create(&targetSweepThread, NULL, TargetSet_sweepFunc, &targets)))
+        {
+            fprintf(stderr, "pthread_create (targets): %d\n", pc);
+            exit(pc);
+        }
+    }
 
-    nanosleep(&blinkTime, NULL);
-    TOGGLE_ALL(fds, LED_OFF);
+    // key discovery overlaps the threads' own connects
+    printf("Querying expected key sets...\n");
+    RedisConnection_t rConn = newConnection(&psubThreadArgs, ReconnectLink_Sweep);
+    // Reconnect_until only gives up when shutdown was requested mid-startup
+    if (rConn < 1)
+        exit(Shutdown_requested() ? 0 : 42);
+
+    RedisArray_t* keySets[CONFIG_MAX_PATTERNS];
+    size_t keySetCount = 0;
+    uint64_t keysGeneration = initialConfig.keysGeneration;
 
-    printf("spheremon fully initialized.\n");
+    if (!loadKeySets(rConn, &initialConfig, keySets, &keySetCount))
+    {
+        fprintf(stderr, "Failed to query key sets we expected\n");
+        exit(-2);
+    }
+
+    Startup_ready(&startup, StartupPhase_Keys);
+
+    printf("Monitoring %d keys every %ds\n", trackedKeyCount, KEY_CHECK_CADENCE_SECONDS);
+
+    Startup_wait(&startup, STARTUP_THREADS, &running);
+    LedEngine_clear(&ledEngine, LedSignal_Connecting);
+
+    char phases[192];
+    Startup_format(&startup, phases, sizeof(phases));
+    printf("spheremon fully initialized: %s\n", phases);
     fflush(stdout);
 
     // printing to serial automatically lights the orange "App" LED, which from
@@ -456,33 +1541,90 @@ int main(int argc, char** argv)
     // via the print statements emitted to serial from psubThreadFunc. nothing else should
     // print to serial, so as to allow that LED to function  command-response indicator
 
+    Schedule_init(&sweepSchedule);
     while (running)
     {
-        lastLost = checkKeys(rConn, rpjiosKeys) + checkKeys(rConn, zerowatchKeys);
-        if (lastLost)
+        // copied out so the read section never spans redis round trips
+        Config_t cfg = *Config_enter(ConfigReader_Main);
+        Config_exit(ConfigReader_Main);
+
+        // EXISTS can't tell a missing key from a dead link, so check the link
+        // first rather than flag every key lost
+        if (!Reconnect_ping(rConn))
         {
-            GPIO_SetValue(fds[LOST_LED], LED_ON);
-            for (int i = 0; i < lastLost; i++)
-            {
-                GPIO_SetValue(fds[LOST_PULSE_LED], LED_ON);
-                nanosleep(&blinkTime, NULL);
-                GPIO_SetValue(fds[LOST_PULSE_LED], LED_OFF);
-                nanosleep(&blinkTime, NULL);
-            }
+            fprintf(stderr, "sweep connection lost, reconnecting\n");
+            if (rConn > 0)
+                closeConnection(&psubThreadArgs, rConn);
+            Reconnect_lost(ReconnectLink_Sweep);
+            if ((rConn = newConnection(&psubThreadArgs, ReconnectLink_Sweep)) < 1)
+                break;
+        }
+
+        if (cfg.keysGeneration != keysGeneration && loadKeySets(rConn, &cfg, keySets, &keySetCount))
+            keysGeneration = cfg.keysGeneration;
+
+        int lost = checkKeys(rConn, &keyTable);
+        if (lost < 0)
+        {
+            // the PING at the top of the next pass reconnects; lastLost and
+            // the LEDs keep showing the last complete sweep until then
+            fprintf(stderr, "sweep connection failed mid-sweep, abandoning it\n");
+            closeConnection(&psubThreadArgs, rConn);
+            rConn = -1;
+            Reconnect_lost(ReconnectLink_Sweep);
         }
         else
         {
-            TOGGLE_ALL(fds, LED_OFF);
+            Counter_set(&lastLost, lost);
+            if (lost)
+            {
+                LedEngine_raise(&ledEngine, LedSignal_LostKeys, 0);
+                LedEngine_raise(&ledEngine, LedSignal_LostPulses, (uint32_t)lost);
+            }
+            else
+            {
+                LedEngine_clear(&ledEngine, LedSignal_LostKeys);
+                LedEngine_clear(&ledEngine, LedSignal_LostPulses);
+            }
         }
 
         fflush(stdout);
         fflush(stderr);
-        nanosleep(&loopTime, NULL);
+
+        // the next sweep is due a cadence after this one was, however long it took
+        if (!Schedule_wait(&sweepSchedule, cfg.keyCheckCadenceSeconds * 1000))
+            break;
     }
 
-    printf("spheremon exiting (%d children left)...\n", threadRunningCount);
+    // wake every thread blocked in a read; the watch thread's connection
+    // isn't tracked, so it can still flush the last partial interval (in
+    // mux builds that flush is bounded by MUX_REPLY_TIMEOUT_SECONDS)
+    int cut = Shutdown_cutTracked();
+    printf("spheremon exiting (%d children left, %d connections cut)...\n",
+        Startup_runningCount(&startup, STARTUP_THREADS), cut);
+    pthread_join(watchThread, NULL);
+#if RESP3_MUX
+    Mux_shutdown(&mux);
+    pthread_join(muxThread, NULL);
+#else
     pthread_join(psubThread, NULL);
     pthread_join(commandThread, NULL);
-    printf("spheremon done, tracked %d total messages.\n", msgCount);
+#endif
+    CmdQueue_close(&cmdQueue);
+    for (int i = 0; i < CMD_WORKER_COUNT; i++)
+        pthread_join(cmdWorkers[i], NULL);
+    pthread_join(cmdStreamThread, NULL);
+    if (targets.count)
+    {
+        pthread_join(targetActivityThread, NULL);
+        pthread_join(targetSweepThread, NULL);
+    }
+    if (sentinelMode)
+        Sentinel_stop(&sentinel);
+    LedEngine_stop(&ledEngine);
+    if (rConn > 0)
+        closeConnection(&psubThreadArgs, rConn);
+    printf("spheremon done in %ums, tracked %lld total messages.\n", Shutdown_elapsedMs(),
+        (long long)Counter_read(&msgCount));
     fflush(stdout);
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "metricsframe.h"
+
+#define FIXED_HEADER_SIZE 12
+
+static void putLE16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void putLE32(uint8_t* p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint16_t getLE16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getLE32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static size_t putVarint(uint8_t* p, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static size_t getVarint(const uint8_t* p, size_t len, uint64_t* v)
+{
+    uint64_t r = 0;
+    for (size_t n = 0; n < len && n < 10; n++)
+    {
+        r |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+        if (!(p[n] & 0x80))
+        {
+            *v = r;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static uint64_t zigzag(uint64_t cur, uint64_t prev)
+{
+    int64_t d = (int64_t)(cur - prev);
+    return ((uint64_t)d << 1) ^ (uint64_t)(d >> 63);
+}
+
+static uint64_t unzigzag(uint64_t z, uint64_t prev)
+{
+    int64_t d = (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+    return prev + (uint64_t)d;
+}
+
+void MetricsFrameCodec_init(MetricsFrameCodec_t* codec)
+{
+    memset(codec, 0, sizeof(*codec));
+}
+
+void MetricsFrameCodec_requestKeyFrame(MetricsFrameCodec_t* codec)
+{
+    codec->sinceKey = METRICS_FRAME_KEY_INTERVAL;
+}
+
+size_t MetricsFrame_encode(MetricsFrameCodec_t* codec, MetricsFrame_t* frame, uint8_t* buf, size_t bufLen)
+{
+    if (bufLen < METRICS_FRAME_MAX_SIZE)
+        return 0;
+
+    bool key = !codec->primed || codec->sinceKey >= METRICS_FRAME_KEY_INTERVAL;
+    frame->seq = codec->primed ? (uint16_t)(codec->prev.seq + 1) : 0;
+
+    buf[0] = METRICS_FRAME_VERSION;
+    buf[1] = key ? METRICS_FRAME_FLAG_KEY : 0;
+    putLE16(buf + 2, frame->seq);
+    putLE32(buf + 4, frame->perSecX100);
+    putLE32(buf + 8, frame->curPerSecX100);
+
+    size_t off = FIXED_HEADER_SIZE;
+    const MetricsFrame_t* p = &codec->prev;
+    off += putVarint(buf + off, key ? frame->uptime : zigzag(frame->uptime, p->uptime));
+    off += putVarint(buf + off, key ? frame->msgCount : zigzag(frame->msgCount, p->msgCount));
+    off += putVarint(buf + off, frame->intervalCount);
+    off += putVarint(buf + off, key ? frame->trackedKeys : zigzag(frame->trackedKeys, p->trackedKeys));
+    off += putVarint(buf + off, key ? frame->lostKeys : zigzag(frame->lostKeys, p->lostKeys));
+
+    codec->sinceKey = key ? 1 : codec->sinceKey + 1;
+    codec->prev = *frame;
+    codec->primed = true;
+    return off;
+}
+
+int MetricsFrame_decode(MetricsFrameCodec_t* codec, const uint8_t* buf, size_t bufLen, MetricsFrame_t* out)
+{
+    if (bufLen < FIXED_HEADER_SIZE)
+        return MetricsFrameError_Truncated;
+    if (buf[0] != METRICS_FRAME_VERSION)
+        return MetricsFrameError_Version;
+
+    bool key = buf[1] & METRICS_FRAME_FLAG_KEY;
+    MetricsFrame_t f;
+    f.seq = getLE16(buf + 2);
+    f.perSecX100 = getLE32(buf + 4);
+    f.curPerSecX100 = getLE32(buf + 8);
+
+    uint64_t v[5];
+    size_t off = FIXED_HEADER_SIZE;
+    for (int i = 0; i < 5; i++)
+    {
+        size_t n = getVarint(buf + off, bufLen - off, &v[i]);
+        if (!n)
+            return MetricsFrameError_Truncated;
+        off += n;
+    }
+
+    if (!key && !codec->primed)
+        return MetricsFrameError_NeedKeyFrame;
+
+    // a delta against anything but the frame right before it is meaningless;
+    // drop back to waiting for a key frame rather than report drifted values
+    if (!key && f.seq != (uint16_t)(codec->prev.seq + 1))
+    {
+        codec->primed = false;
+        return MetricsFrameError_NeedKeyFrame;
+    }
+
+    const MetricsFrame_t* p = &codec->prev;
+    f.uptime = key ? v[0] : unzigzag(v[0], p->uptime);
+    f.msgCount = key ? v[1] : unzigzag(v[1], p->msgCount);
+    f.intervalCount = v[2];
+    f.trackedKeys = key ? v[3] : unzigzag(v[3], p->trackedKeys);
+    f.lostKeys = key ? v[4] : unzigzag(v[4], p->lostKeys);
+
+    codec->prev = f;
+    codec->primed = true;
+    *out = f;
+    return (int)off;
+}
+
+int MetricsFrame_format(const MetricsFrame_t* f, char* buf, size_t bufLen)
+{
+    double perSec = f->perSecX100 / 100.0, curPerSec = f->curPerSecX100 / 100.0;
+    return snprintf(buf, bufLen, "[%06llu] %-6llu %-6llu %-3llu %5.2f %5.2f %s",
+        (unsigned long long)f->uptime, (unsigned long long)f->msgCount,
+        (unsigned long long)(f->msgCount - f->intervalCount), (unsigned long long)f->intervalCount,
+        perSec, curPerSec, (curPerSec > perSec * 1.5 ? "!>!" : (curPerSec < perSec * 0.5 ? "!<!" : "")));
+}
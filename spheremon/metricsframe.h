@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compact binary form of the watch thread's metrics line, published on
+// METRICS_FRAME_CHANNEL when METRICS_BINARY_FRAMES is enabled.
+//
+// Wire layout (version 1), all fixed fields little-endian:
+//   u8  version
+//   u8  flags            (METRICS_FRAME_FLAG_*)
+//   u16 seq              wraps; a gap means a dropped frame
+//   u32 perSecX100       running average msg/s * 100
+//   u32 curPerSecX100    last interval msg/s * 100
+//   varint uptime        seconds
+//   varint msgCount
+//   varint intervalCount  messages since the previous frame (always absolute)
+//   varint trackedKeys
+//   varint lostKeys
+// In a key frame the varints are absolute values; otherwise all but
+// intervalCount are the zigzag-encoded difference from the previous frame. Encoders emit a key
+// frame every METRICS_FRAME_KEY_INTERVAL frames so late joiners can sync.
+
+#define METRICS_FRAME_CHANNEL       "spheremon:watchthread:bin"
+#define METRICS_FRAME_VERSION       1
+#define METRICS_FRAME_FLAG_KEY      0x01
+#define METRICS_FRAME_KEY_INTERVAL  12
+#define METRICS_FRAME_MAX_SIZE      (12 + 5 * 10)
+
+typedef struct MetricsFrame
+{
+    uint16_t seq;
+    uint32_t perSecX100;
+    uint32_t curPerSecX100;
+    uint64_t uptime;
+    uint64_t msgCount;
+    uint64_t intervalCount;
+    uint64_t trackedKeys;
+    uint64_t lostKeys;
+} MetricsFrame_t;
+
+typedef struct MetricsFrameCodec
+{
+    bool primed;
+    unsigned sinceKey;
+    MetricsFrame_t prev;
+} MetricsFrameCodec_t;
+
+typedef enum MetricsFrameError
+{
+    MetricsFrameError_Truncated = -1,
+    MetricsFrameError_Version = -2,
+    MetricsFrameError_NeedKeyFrame = -3,
+} MetricsFrameError_t;
+
+void MetricsFrameCodec_init(MetricsFrameCodec_t* codec);
+
+// Makes the next MetricsFrame_encode() emit a key frame.
+void MetricsFrameCodec_requestKeyFrame(MetricsFrameCodec_t* codec);
+
+// Encodes frame (its seq is assigned by the codec) into buf, which should hold
+// METRICS_FRAME_MAX_SIZE bytes. Returns the encoded length, or 0 if buf is too small.
+size_t MetricsFrame_encode(MetricsFrameCodec_t* codec, MetricsFrame_t* frame, uint8_t* buf, size_t bufLen);
+
+// Decodes one frame from buf. Returns bytes consumed (> 0) or a MetricsFrameError_t.
+// Delta frames seen before the first key frame, or after a seq gap, yield
+// MetricsFrameError_NeedKeyFrame until the next key frame arrives.
+int MetricsFrame_decode(MetricsFrameCodec_t* codec, const uint8_t* buf, size_t bufLen, MetricsFrame_t* out);
+
+// Renders a frame in the same layout as the watch thread's text line.
+// Returns what snprintf() returns.
+int MetricsFrame_format(const MetricsFrame_t* frame, char* buf, size_t bufLen);
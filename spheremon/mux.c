@@ -0,0 +1,251 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "mux.h"
+#include "resp.h"
+
+#define MUX_STACK_BUF_SIZE 1024
+
+static void failAll(Mux_t* mux)
+{
+    mux->dead = true;
+    for (MuxCall_t* call = mux->head; call; call = call->next)
+        call->failed = call->done = true;
+    mux->head = mux->tail = NULL;
+    pthread_cond_broadcast(&mux->completed);
+}
+
+static void* readerFunc(void* arg)
+{
+    Mux_t* mux = (Mux_t*)arg;
+    Resp3Value_t value;
+
+    while (Resp3_read(&mux->in, &value))
+    {
+        if (value.type == Resp3Type_Push)
+        {
+            if (mux->onPush)
+                mux->onPush(&value, mux->pushCtx);
+            Resp3_free(&value);
+            continue;
+        }
+
+        pthread_mutex_lock(&mux->lock);
+        MuxCall_t* call = mux->head;
+        if (!call)
+        {
+            // a reply nobody asked for means we've lost track of the stream
+            pthread_mutex_unlock(&mux->lock);
+            Resp3_free(&value);
+            fprintf(stderr, "mux: unexpected reply, dropping connection\n");
+            break;
+        }
+
+        call->replies[call->received++] = value;
+        if (call->received == call->replyCount)
+        {
+            call->done = true;
+            if (!(mux->head = call->next))
+                mux->tail = NULL;
+            pthread_cond_broadcast(&mux->completed);
+        }
+        pthread_mutex_unlock(&mux->lock);
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    failAll(mux);
+    pthread_mutex_unlock(&mux->lock);
+    return NULL;
+}
+
+void Mux_init(Mux_t* mux, MuxPushHandler_t onPush, void* pushCtx)
+{
+    memset(mux, 0, sizeof(*mux));
+    mux->fd = -1;
+    mux->dead = true;
+    mux->onPush = onPush;
+    mux->pushCtx = pushCtx;
+    pthread_mutex_init(&mux->lock, NULL);
+
+    // call deadlines are monotonic, so a clock step can't stretch or cut them
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mux->completed, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+bool Mux_start(Mux_t* mux, int fd, const char* pass)
+{
+    // still dead, so nobody else touches fd or the reader until this succeeds
+    Resp3Reader_init(&mux->in, fd);
+
+    // handshake before the reader thread exists, so it's read inline, under
+    // a receive timeout that's lifted again for the reader's idle waits
+    const char* hello[] = { "HELLO", "3", "AUTH", "default", pass };
+    Resp3Value_t reply = { 0 };
+    Resp_setReplyTimeout(fd, MUX_REPLY_TIMEOUT_SECONDS);
+    bool ok = Resp_sendCommand(fd, pass && *pass ? 5 : 2, hello, NULL) && Resp3_read(&mux->in, &reply);
+    if (ok && !(ok = reply.type == Resp3Type_Map))
+        fprintf(stderr, "HELLO 3 failed: %s\n", reply.str ? reply.str : "unexpected reply");
+    else if (!ok)
+        fprintf(stderr, "HELLO 3 failed: no reply\n");
+    Resp3_free(&reply);
+    Resp_setReplyTimeout(fd, 0);
+
+    pthread_mutex_lock(&mux->lock);
+    mux->fd = fd;
+    mux->head = mux->tail = NULL;
+    mux->dead = !ok;
+    if (ok && !(mux->readerRunning = !pthread_create(&mux->reader, NULL, readerFunc, mux)))
+        mux->dead = true;
+    ok = !mux->dead;
+    if (!ok)
+        mux->fd = -1;
+    pthread_mutex_unlock(&mux->lock);
+
+    if (!ok)
+        close(fd);
+    return ok;
+}
+
+bool Mux_callRaw(Mux_t* mux, const char* buf, size_t len, Resp3Value_t* replies, size_t replyCount)
+{
+    MuxCall_t call = { .replies = replies, .replyCount = replyCount };
+    memset(replies, 0, replyCount * sizeof(Resp3Value_t));
+
+    pthread_mutex_lock(&mux->lock);
+    if (mux->dead)
+    {
+        pthread_mutex_unlock(&mux->lock);
+        return false;
+    }
+
+    // queue before sending so the reader can never see the reply first;
+    // both happen under the lock so queue order matches wire order
+    if (mux->tail)
+        mux->tail->next = &call;
+    else
+        mux->head = &call;
+    mux->tail = &call;
+
+    if (!Resp_sendRaw(mux->fd, buf, len))
+    {
+        shutdown(mux->fd, SHUT_RDWR);
+        failAll(mux);
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += MUX_REPLY_TIMEOUT_SECONDS;
+    while (!call.done)
+    {
+        if (pthread_cond_timedwait(&mux->completed, &mux->lock, &deadline) == ETIMEDOUT && !call.done)
+        {
+            // the replies still owed would land on later calls; start over
+            fprintf(stderr, "mux: no reply in %ds, dropping connection\n", MUX_REPLY_TIMEOUT_SECONDS);
+            shutdown(mux->fd, SHUT_RDWR);
+            failAll(mux);
+        }
+    }
+    pthread_mutex_unlock(&mux->lock);
+
+    if (call.failed)
+    {
+        for (size_t i = 0; i < call.received; i++)
+            Resp3_free(&replies[i]);
+        return false;
+    }
+    return true;
+}
+
+bool Mux_call(Mux_t* mux, int argc, const char** argv, Resp3Value_t* reply)
+{
+    char stackBuf[MUX_STACK_BUF_SIZE];
+    size_t need = 32;
+    for (int i = 0; i < argc; i++)
+        need += 32 + strlen(argv[i]);
+
+    char* buf = need <= sizeof(stackBuf) ? stackBuf : (char*)malloc(need);
+    if (!buf)
+        return false;
+
+    size_t len = Resp_encodeCommand(buf, need, argc, argv, NULL);
+    bool ok = len && Mux_callRaw(mux, buf, len, reply, 1);
+
+    if (buf != stackBuf)
+        free(buf);
+    return ok;
+}
+
+bool Mux_transport(void* ctx, const char* buf, size_t len, size_t replyCount)
+{
+    Resp3Value_t stackReplies[4];
+    Resp3Value_t* replies = replyCount <= 4 ? stackReplies : (Resp3Value_t*)malloc(replyCount * sizeof(Resp3Value_t));
+    if (!replies)
+        return false;
+
+    bool ok = Mux_callRaw((Mux_t*)ctx, buf, len, replies, replyCount);
+    for (size_t i = 0; ok && i < replyCount; i++)
+        ok = replies[i].type != Resp3Type_Error && replies[i].type != Resp3Type_BulkError;
+    for (size_t i = 0; i < replyCount && replies[i].type; i++)
+        Resp3_free(&replies[i]);
+
+    if (replies != stackReplies)
+        free(replies);
+    return ok;
+}
+
+bool Mux_isAlive(Mux_t* mux)
+{
+    pthread_mutex_lock(&mux->lock);
+    bool alive = !mux->dead;
+    pthread_mutex_unlock(&mux->lock);
+    return alive;
+}
+
+bool Mux_send(Mux_t* mux, int argc, const char** argv)
+{
+    pthread_mutex_lock(&mux->lock);
+    bool ok = !mux->dead && Resp_sendCommand(mux->fd, argc, argv, NULL);
+    pthread_mutex_unlock(&mux->lock);
+    return ok;
+}
+
+void Mux_wait(Mux_t* mux)
+{
+    pthread_mutex_lock(&mux->lock);
+    while (!mux->dead)
+        pthread_cond_wait(&mux->completed, &mux->lock);
+    pthread_mutex_unlock(&mux->lock);
+}
+
+void Mux_shutdown(Mux_t* mux)
+{
+    pthread_mutex_lock(&mux->lock);
+    if (mux->fd > 0)
+        shutdown(mux->fd, SHUT_RDWR);
+    pthread_mutex_unlock(&mux->lock);
+}
+
+void Mux_stop(Mux_t* mux)
+{
+    Mux_shutdown(mux);
+    if (mux->readerRunning)
+    {
+        pthread_join(mux->reader, NULL);
+        mux->readerRunning = false;
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    failAll(mux);
+    if (mux->fd > 0)
+        close(mux->fd);
+    mux->fd = -1;
+    pthread_mutex_unlock(&mux->lock);
+}
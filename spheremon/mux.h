@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "resp3.h"
+
+// One RESP3 (HELLO 3) connection shared by subscriptions and ordinary
+// commands. A reader thread demultiplexes: push messages go to the push
+// handler, every other reply completes the oldest outstanding call.
+// Subscribe-family commands must go through Mux_send, since in RESP3 their
+// confirmations arrive as pushes rather than replies.
+//
+// A Mux_t outlives its connections: Mux_init once, then Mux_start and
+// Mux_stop per connection. Between a drop and the next successful start,
+// calls fail fast rather than block, so the owner can reconnect and
+// resubscribe from its own thread while the others carry on.
+//
+// A call waits at most MUX_REPLY_TIMEOUT_SECONDS for its replies, as the
+// RESP2 connections' reply timeouts do. A server that stays connected but
+// stops answering gets its socket shut down, which fails every outstanding
+// call and drops the connection for the owner to reconnect.
+
+#define MUX_REPLY_TIMEOUT_SECONDS 2
+
+// Runs on the reader thread: it may use Mux_send but must not wait on Mux_call.
+typedef void (*MuxPushHandler_t)(const Resp3Value_t* push, void* ctx);
+
+typedef struct MuxCall
+{
+    struct MuxCall* next;
+    Resp3Value_t* replies;
+    size_t replyCount;
+    size_t received;
+    bool done;
+    bool failed;
+} MuxCall_t;
+
+typedef struct Mux
+{
+    int fd;
+    bool dead;                      // no usable connection: not started, or dropped
+    bool readerRunning;
+    pthread_t reader;
+    pthread_mutex_t lock;           // guards writes and the call queue
+    pthread_cond_t completed;
+    MuxCall_t* head;
+    MuxCall_t* tail;
+    MuxPushHandler_t onPush;
+    void* pushCtx;
+    Resp3Reader_t in;
+} Mux_t;
+
+// Once, before any other call; the mux starts out dead.
+void Mux_init(Mux_t* mux, MuxPushHandler_t onPush, void* pushCtx);
+
+// Takes ownership of fd (connected, not yet authenticated), runs
+// HELLO 3 [AUTH default pass] (bounded by MUX_REPLY_TIMEOUT_SECONDS) and
+// starts the reader thread. The previous connection must have been stopped.
+// On failure fd is closed.
+bool Mux_start(Mux_t* mux, int fd, const char* pass);
+
+// Sends pre-encoded requests (see Resp_encodeCommand) and waits for their
+// replyCount replies, in order. Free each with Resp3_free. False if the
+// connection failed or timed out before all replies arrived.
+bool Mux_callRaw(Mux_t* mux, const char* buf, size_t len, Resp3Value_t* replies, size_t replyCount);
+
+bool Mux_call(Mux_t* mux, int argc, const char** argv, Resp3Value_t* reply);
+
+// RespTransport_t (see resp.h) over a mux; ctx is a Mux_t*.
+bool Mux_transport(void* ctx, const char* buf, size_t len, size_t replyCount);
+
+bool Mux_isAlive(Mux_t* mux);
+
+// Sends a request whose only responses are pushes (SUBSCRIBE, PSUBSCRIBE, ...).
+bool Mux_send(Mux_t* mux, int argc, const char** argv);
+
+// Blocks until the connection drops (or Mux_shutdown is called).
+void Mux_wait(Mux_t* mux);
+
+// Shuts the socket down, so the reader fails every outstanding call and
+// Mux_wait returns; the connection still needs a Mux_stop.
+void Mux_shutdown(Mux_t* mux);
+
+// Shuts the socket down, fails outstanding calls, joins the reader and
+// closes the socket. A no-op if nothing was started.
+void Mux_stop(Mux_t* mux);
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "reconnect.h"
+#include "resp.h"
+#include "shutdown.h"
+
+static ReconnectStats_t stats[ReconnectLink_Count];
+
+static const char* linkNames[ReconnectLink_Count] = {
+    "sweep", "activity", "command", "watch", "command-stream", "mux"
+};
+
+static uint64_t nowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+void Reconnect_lost(ReconnectLink_t link)
+{
+    uint64_t up = 0;
+    atomic_compare_exchange_strong(&stats[link].downSinceMs, &up, nowMs());
+}
+
+static void markUp(ReconnectLink_t link)
+{
+    ReconnectStats_t* s = &stats[link];
+    uint64_t since = atomic_exchange(&s->downSinceMs, 0);
+    if (atomic_exchange(&s->established, true) && since)
+    {
+        uint64_t down = nowMs() - since;
+        atomic_fetch_add(&s->reconnects, 1);
+        atomic_fetch_add(&s->downtimeMs, down);
+        atomic_store(&s->lastDowntimeMs, down);
+    }
+}
+
+RedisConnection_t Reconnect_tryOnce(ReconnectLink_t link, Reconnect_connect_t connect, void* ctx)
+{
+    RedisConnection_t conn = connect(ctx);
+    if (conn > 0)
+        markUp(link);
+    else
+        Reconnect_lost(link);
+    return conn;
+}
+
+RedisConnection_t Reconnect_until(ReconnectLink_t link, Reconnect_connect_t connect, void* ctx,
+    volatile sig_atomic_t* running)
+{
+    unsigned seed = (unsigned)nowMs() ^ ((unsigned)link << 16);
+    uint32_t ceilingMs = RECONNECT_BASE_MS;
+
+    while (*running)
+    {
+        RedisConnection_t conn = Reconnect_tryOnce(link, connect, ctx);
+        if (conn > 0)
+            return conn;
+
+        uint32_t delayMs = ceilingMs / 2 + (uint32_t)rand_r(&seed) % (ceilingMs / 2 + 1);
+        fprintf(stderr, "%s connection failed, retrying in %ums\n", linkNames[link], delayMs);
+        fflush(stderr);
+
+        // a shutdown request cuts a long backoff short
+        if (!Shutdown_sleep(delayMs))
+            break;
+
+        ceilingMs = ceilingMs * 2 > RECONNECT_CAP_MS ? RECONNECT_CAP_MS : ceilingMs * 2;
+    }
+    return -1;
+}
+
+bool Reconnect_ping(RedisConnection_t conn)
+{
+    const char* ping[] = { "PING" };
+    if (conn < 1 || !Resp_sendCommand(conn, 1, ping, NULL))
+        return false;
+
+    RedisObject_t reply = RedisConnection_getNextObject(conn);
+    bool ok = reply.type == RedisObjectType_SimpleString;
+    RedisObject_dealloc(reply);
+    return ok;
+}
+
+size_t Reconnect_formatStats(char* buf, size_t bufLen)
+{
+    size_t off = 0;
+    uint64_t now = nowMs();
+    buf[0] = '\0';
+
+    for (int i = 0; i < ReconnectLink_Count && off < bufLen; i++)
+    {
+        ReconnectStats_t* s = &stats[i];
+        uint64_t downSince = atomic_load(&s->downSinceMs);
+        off += (size_t)snprintf(buf + off, bufLen - off, "%s%s reconnects=%u downtime=%.1fs last=%.1fs",
+            i ? "; " : "", linkNames[i], atomic_load(&s->reconnects),
+            atomic_load(&s->downtimeMs) / 1000.0, atomic_load(&s->lastDowntimeMs) / 1000.0);
+        if (downSince && off < bufLen)
+            off += (size_t)snprintf(buf + off, bufLen - off, " DOWN %.1fs", (now - downSince) / 1000.0);
+    }
+    return off < bufLen ? off : bufLen - 1;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+
+#include <yarl.h>
+
+// Reconnect supervision for the long-lived connections. A dropped link is
+// retried with capped exponential backoff and equal jitter (half the delay
+// fixed, half random), so a server restart isn't met by every thread of every
+// device at the same instant. Each link's reconnects and accumulated
+// downtime are kept for the reconnects command; the first connection of a
+// link doesn't count as a reconnect.
+
+#define RECONNECT_BASE_MS 250
+#define RECONNECT_CAP_MS 30000
+
+typedef enum ReconnectLink
+{
+    ReconnectLink_Sweep = 0,
+    ReconnectLink_Activity,
+    ReconnectLink_Command,
+    ReconnectLink_Watch,
+    ReconnectLink_CommandStream,
+    ReconnectLink_Mux,              // RESP3_MUX builds only
+    ReconnectLink_Count
+} ReconnectLink_t;
+
+typedef RedisConnection_t (*Reconnect_connect_t)(void* ctx);
+
+typedef struct ReconnectStats
+{
+    _Atomic uint32_t reconnects;
+    _Atomic bool established;
+    _Atomic uint64_t downSinceMs;       // 0 while up
+    _Atomic uint64_t downtimeMs;        // completed outages only
+    _Atomic uint64_t lastDowntimeMs;
+} ReconnectStats_t;
+
+// Calls connect until it returns a connection, backing off between tries.
+// Returns a value < 1 only if *running clears first.
+RedisConnection_t Reconnect_until(ReconnectLink_t link, Reconnect_connect_t connect, void* ctx,
+    volatile sig_atomic_t* running);
+
+// A single attempt, for links that retry on their own schedule.
+RedisConnection_t Reconnect_tryOnce(ReconnectLink_t link, Reconnect_connect_t connect, void* ctx);
+
+// Starts the downtime clock when a link's drop is detected.
+void Reconnect_lost(ReconnectLink_t link);
+
+// PING round trip; false if the connection is gone.
+bool Reconnect_ping(RedisConnection_t conn);
+
+// "<link> reconnects=N downtime=Xs last=Ys[ DOWN Zs]; ..."
+size_t Reconnect_formatStats(char* buf, size_t bufLen);
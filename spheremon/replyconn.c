@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "replyconn.h"
+#include "resp.h"
+
+#define REPLY_TIMEOUT_SECONDS 2
+
+void ReplyConnection_init(ReplyConnection_t* rc, ReplyConnection_connect_t connect,
+    ReplyConnection_close_t disconnect, void* ctx)
+{
+    rc->conn = -1;
+    rc->connect = connect;
+    rc->disconnect = disconnect;
+    rc->ctx = ctx;
+    rc->opened = false;
+    rc->reconnects = 0;
+}
+
+void ReplyConnection_close(ReplyConnection_t* rc)
+{
+    if (rc->conn > 0 && rc->disconnect)
+        rc->disconnect(rc->ctx, rc->conn);
+    else if (rc->conn > 0)
+        close(rc->conn);
+    rc->conn = -1;
+}
+
+static bool ensureConnected(ReplyConnection_t* rc)
+{
+    if (rc->conn > 0)
+        return true;
+
+    if ((rc->conn = rc->connect(rc->ctx)) < 1)
+        return false;
+
+    Resp_setReplyTimeout(rc->conn, REPLY_TIMEOUT_SECONDS);
+    if (rc->opened)
+        rc->reconnects++;
+    rc->opened = true;
+    return true;
+}
+
+typedef enum PipelineResult
+{
+    PipelineResult_Ok,
+    PipelineResult_Replied,         // redis answered, but with an error
+    PipelineResult_LinkFailed,      // nothing usable came back; safe to resend
+} PipelineResult_t;
+
+static PipelineResult_t pipelineOnce(ReplyConnection_t* rc, const char* buf, size_t len)
+{
+    if (!ensureConnected(rc) || !Resp_sendRaw(rc->conn, buf, len))
+        return PipelineResult_LinkFailed;
+
+    RedisObject_t setReply = RedisConnection_getNextObject(rc->conn);
+    RedisObject_t pubReply = RedisConnection_getNextObject(rc->conn);
+    PipelineResult_t result = PipelineResult_Replied;
+    if (setReply.type == RedisObjectType_Invalid || pubReply.type == RedisObjectType_Invalid)
+        result = PipelineResult_LinkFailed;
+    else if (setReply.type == RedisObjectType_SimpleString && pubReply.type == RedisObjectType_Integer)
+        result = PipelineResult_Ok;
+    RedisObject_dealloc(setReply);
+    RedisObject_dealloc(pubReply);
+    return result;
+}
+
+bool ReplyConnection_setAndPublish(ReplyConnection_t* rc, const char* key, const char* value)
+{
+    const char* setArgs[] = { "SET", key, value };
+    const char* pubArgs[] = { "PUBLISH", key, value };
+    size_t need = 128 + 2 * (strlen(key) + strlen(value));
+    char* buf = (char*)malloc(need);
+    if (!buf)
+        return false;
+
+    size_t setLen = Resp_encodeCommand(buf, need, 3, setArgs, NULL);
+    size_t pubLen = setLen ? Resp_encodeCommand(buf + setLen, need - setLen, 3, pubArgs, NULL) : 0;
+    if (!pubLen)
+    {
+        free(buf);
+        return false;
+    }
+    size_t len = setLen + pubLen;
+
+    PipelineResult_t result = pipelineOnce(rc, buf, len);
+    if (result == PipelineResult_LinkFailed)
+    {
+        // a stale connection (server restart, idle timeout) fails here first;
+        // if only the PUBLISH reply was lost it may go out twice, but an
+        // error reply (WRONGTYPE, OOM) means redis saw both and is never resent
+        ReplyConnection_close(rc);
+        if ((result = pipelineOnce(rc, buf, len)) == PipelineResult_LinkFailed)
+            ReplyConnection_close(rc);
+    }
+
+    free(buf);
+    return result == PipelineResult_Ok;
+}
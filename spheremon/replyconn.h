@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <yarl.h>
+
+// Long-lived connection for command replies. It is opened on first use and
+// reopened after any failure, so answering a command costs one pipelined
+// SET+PUBLISH round trip instead of a connect, AUTH and teardown.
+
+typedef RedisConnection_t (*ReplyConnection_connect_t)(void* ctx);
+typedef void (*ReplyConnection_close_t)(void* ctx, RedisConnection_t conn);
+
+typedef struct ReplyConnection
+{
+    RedisConnection_t conn;
+    ReplyConnection_connect_t connect;
+    ReplyConnection_close_t disconnect;
+    void* ctx;
+    bool opened;                // a connection has been made before
+    unsigned reconnects;        // connections made after the first
+} ReplyConnection_t;
+
+// connect returns a ready (authenticated) connection, or a value < 1 on failure;
+// disconnect, if not NULL, closes one in place of close().
+void ReplyConnection_init(ReplyConnection_t* rc, ReplyConnection_connect_t connect,
+    ReplyConnection_close_t disconnect, void* ctx);
+
+// SETs key to value and PUBLISHes value on channel key, both in one write,
+// then reads both replies. Retries once on a fresh connection if the link
+// failed; an error reply from redis is not retried, so nothing is published twice.
+bool ReplyConnection_setAndPublish(ReplyConnection_t* rc, const char* key, const char* value);
+
+void ReplyConnection_close(ReplyConnection_t* rc);
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "resp.h"
+
+#define RESP_STACK_BUF_SIZE 512
+
+static size_t appendHeader(char* buf, size_t bufLen, char type, size_t n)
+{
+    int w = snprintf(buf, bufLen, "%c%zu\r\n", type, n);
+    return (w < 0 || (size_t)w >= bufLen) ? 0 : (size_t)w;
+}
+
+size_t Resp_encodeCommand(char* buf, size_t bufLen, int argc, const char** argv, const size_t* argvLen)
+{
+    size_t off = appendHeader(buf, bufLen, '*', (size_t)argc);
+    if (!off)
+        return 0;
+
+    for (int i = 0; i < argc; i++)
+    {
+        size_t len = argvLen ? argvLen[i] : strlen(argv[i]);
+        size_t w = appendHeader(buf + off, bufLen - off, '$', len);
+        if (!w || off + w + len + 2 > bufLen)
+            return 0;
+        off += w;
+        memcpy(buf + off, argv[i], len);
+        off += len;
+        buf[off++] = '\r';
+        buf[off++] = '\n';
+    }
+
+    return off;
+}
+
+bool Resp_sendRaw(RedisConnection_t conn, const char* buf, size_t len)
+{
+    while (len)
+    {
+        ssize_t sent = send(conn, buf, len, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        buf += sent;
+        len -= (size_t)sent;
+    }
+    return true;
+}
+
+bool Resp_sendCommand(RedisConnection_t conn, int argc, const char** argv, const size_t* argvLen)
+{
+    size_t need = 32;
+    for (int i = 0; i < argc; i++)
+        need += 32 + (argvLen ? argvLen[i] : strlen(argv[i]));
+
+    char stackBuf[RESP_STACK_BUF_SIZE];
+    char* buf = need <= sizeof(stackBuf) ? stackBuf : (char*)malloc(need);
+    if (!buf)
+        return false;
+
+    size_t len = Resp_encodeCommand(buf, need, argc, argv, argvLen);
+    bool ok = len && Resp_sendRaw(conn, buf, len);
+
+    if (buf != stackBuf)
+        free(buf);
+    return ok;
+}
+
+bool Resp_connectionTransport(void* ctx, const char* buf, size_t len, size_t replyCount)
+{
+    RedisConnection_t conn = *(RedisConnection_t*)ctx;
+    if (!Resp_sendRaw(conn, buf, len))
+        return false;
+
+    // always drain every reply so the connection stays in step
+    bool ok = true;
+    for (size_t i = 0; i < replyCount; i++)
+    {
+        RedisObject_t reply = RedisConnection_getNextObject(conn);
+        ok &= reply.type != RedisObjectType_Error && reply.type != RedisObjectType_Invalid;
+        RedisObject_dealloc(reply);
+    }
+    return ok;
+}
+
+bool Resp_publishVia(RespTransport_t transport, void* ctx, const char* channel, const void* payload, size_t payloadLen)
+{
+    const char* argv[] = { "PUBLISH", channel, (const char*)payload };
+    const size_t argvLen[] = { strlen("PUBLISH"), strlen(channel), payloadLen };
+    char stackBuf[RESP_STACK_BUF_SIZE];
+    size_t need = 96 + strlen(channel) + payloadLen;
+    char* buf = need <= sizeof(stackBuf) ? stackBuf : (char*)malloc(need);
+    if (!buf)
+        return false;
+
+    size_t len = Resp_encodeCommand(buf, need, 3, argv, argvLen);
+    bool ok = len && transport(ctx, buf, len, 1);
+
+    if (buf != stackBuf)
+        free(buf);
+    return ok;
+}
+
+bool Resp_publish(RedisConnection_t conn, const char* channel, const void* payload, size_t payloadLen)
+{
+    return Resp_publishVia(Resp_connectionTransport, &conn, channel, payload, payloadLen);
+}
+
+void Resp_setReplyTimeout(RedisConnection_t conn, int seconds)
+{
+    struct timeval tv = { seconds, 0 };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <yarl.h>
+
+// Binary-safe RESP request writer for the cases yarl's string-based helpers
+// can't express (payloads containing NULs, pipelined requests). Replies are
+// still consumed with RedisConnection_getNextObject().
+
+// Appends one RESP array request to buf; returns bytes written, or 0 if it didn't fit.
+size_t Resp_encodeCommand(char* buf, size_t bufLen, int argc, const char** argv, const size_t* argvLen);
+
+// Encodes and sends one request; argvLen may be NULL when all args are C strings.
+bool Resp_sendCommand(RedisConnection_t conn, int argc, const char** argv, const size_t* argvLen);
+
+// Sends a pre-encoded buffer (e.g. several requests from Resp_encodeCommand) in full.
+bool Resp_sendRaw(RedisConnection_t conn, const char* buf, size_t len);
+
+// Bounds how long a reply read can block on a silently-dead peer.
+void Resp_setReplyTimeout(RedisConnection_t conn, int seconds);
+
+// Sends pre-encoded requests and reads their replyCount replies, returning
+// false on a connection error or if any reply is an error. Lets callers
+// work over either a yarl connection or a multiplexed one (see mux.h).
+typedef bool (*RespTransport_t)(void* ctx, const char* buf, size_t len, size_t replyCount);
+
+// RespTransport_t over a yarl connection; ctx is a RedisConnection_t*.
+bool Resp_connectionTransport(void* ctx, const char* buf, size_t len, size_t replyCount);
+
+// PUBLISH with a binary-safe payload.
+bool Resp_publishVia(RespTransport_t transport, void* ctx, const char* channel, const void* payload, size_t payloadLen);
+
+// Resp_publishVia over a yarl connection. Must not be used on a connection
+// in subscribe mode.
+bool Resp_publish(RedisConnection_t conn, const char* channel, const void* payload, size_t payloadLen);
@@ -0,0 +1,255 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "resp3.h"
+
+void Resp3Reader_init(Resp3Reader_t* reader, int fd)
+{
+    reader->fd = fd;
+    reader->off = reader->len = 0;
+}
+
+static bool fill(Resp3Reader_t* r)
+{
+    if (r->off == r->len)
+        r->off = r->len = 0;
+
+    for (;;)
+    {
+        ssize_t n = recv(r->fd, r->buf + r->len, sizeof(r->buf) - r->len, 0);
+        if (n > 0)
+        {
+            r->len += (size_t)n;
+            return true;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        return false;
+    }
+}
+
+// reads a CRLF-terminated line (without the CRLF) into a malloc'd string
+static char* readLine(Resp3Reader_t* r, size_t* lenOut)
+{
+    for (;;)
+    {
+        char* nl = memchr(r->buf + r->off, '\n', r->len - r->off);
+        if (nl)
+        {
+            size_t len = (size_t)(nl - (r->buf + r->off));
+            if (len && nl[-1] == '\r')
+                len--;
+            char* line = (char*)malloc(len + 1);
+            if (line)
+            {
+                memcpy(line, r->buf + r->off, len);
+                line[len] = '\0';
+            }
+            r->off = (size_t)(nl - r->buf) + 1;
+            *lenOut = len;
+            return line;
+        }
+
+        // compact so a long line can use the whole buffer
+        if (r->off)
+        {
+            memmove(r->buf, r->buf + r->off, r->len - r->off);
+            r->len -= r->off;
+            r->off = 0;
+        }
+        if (r->len == sizeof(r->buf) || !fill(r))
+            return NULL;
+    }
+}
+
+static bool readExact(Resp3Reader_t* r, char* dst, size_t n)
+{
+    while (n)
+    {
+        if (r->off == r->len && !fill(r))
+            return false;
+        size_t chunk = r->len - r->off < n ? r->len - r->off : n;
+        memcpy(dst, r->buf + r->off, chunk);
+        r->off += chunk;
+        dst += chunk;
+        n -= chunk;
+    }
+    return true;
+}
+
+static bool readValue(Resp3Reader_t* r, Resp3Value_t* out, int depth)
+{
+    memset(out, 0, sizeof(*out));
+    if (depth > RESP3_MAX_DEPTH)
+        return false;
+
+    size_t lineLen;
+    char* line = readLine(r, &lineLen);
+    if (!line || !lineLen)
+    {
+        free(line);
+        return false;
+    }
+
+    out->type = (Resp3Type_t)line[0];
+    long long n = strtoll(line + 1, NULL, 10);
+    bool ok = true;
+
+    switch (line[0])
+    {
+    case '+': case '-': case ',': case '(':
+        out->len = lineLen - 1;
+        out->str = (char*)malloc(out->len + 1);
+        if ((ok = out->str != NULL))
+            memcpy(out->str, line + 1, out->len + 1);
+        break;
+    case ':':
+        out->integer = n;
+        break;
+    case '#':
+        out->integer = line[1] == 't';
+        break;
+    case '_':
+        break;
+    case '$': case '=': case '!':
+        if (n < 0)
+        {
+            out->type = Resp3Type_Null;
+            break;
+        }
+        out->len = (size_t)n;
+        out->str = (char*)malloc(out->len + 2);
+        ok = out->str && readExact(r, out->str, out->len + 2);
+        if (ok)
+            out->str[out->len] = '\0';
+        break;
+    case '*': case '>': case '~': case '%': case '|':
+        if (n < 0)
+        {
+            out->type = Resp3Type_Null;
+            break;
+        }
+        out->count = (size_t)n * (line[0] == '%' || line[0] == '|' ? 2 : 1);
+        out->items = (Resp3Value_t*)calloc(out->count ? out->count : 1, sizeof(Resp3Value_t));
+        ok = out->items != NULL;
+        for (size_t i = 0; ok && i < out->count; i++)
+            ok = readValue(r, &out->items[i], depth + 1);
+        break;
+    default:
+        ok = false;
+        break;
+    }
+
+    free(line);
+
+    // attributes annotate the value that follows them; drop them
+    if (ok && out->type == '|')
+    {
+        Resp3_free(out);
+        return readValue(r, out, depth);
+    }
+
+    if (!ok)
+        Resp3_free(out);
+    return ok;
+}
+
+bool Resp3_read(Resp3Reader_t* reader, Resp3Value_t* out)
+{
+    return readValue(reader, out, 0);
+}
+
+bool Resp3Reader_receive(Resp3Reader_t* r)
+{
+    if (r->off)
+    {
+        memmove(r->buf, r->buf + r->off, r->len - r->off);
+        r->len -= r->off;
+        r->off = 0;
+    }
+    if (r->len == sizeof(r->buf))
+        return true;
+
+    for (;;)
+    {
+        ssize_t n = recv(r->fd, r->buf + r->len, sizeof(r->buf) - r->len, MSG_DONTWAIT);
+        if (n > 0)
+        {
+            r->len += (size_t)n;
+            return true;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+// 1 if a whole value starts at *p (and moves *p past it), 0 if more bytes are
+// needed, -1 if it's malformed, which Resp3_read will report
+static int scanValue(const char** p, const char* end, int depth)
+{
+    if (depth > RESP3_MAX_DEPTH)
+        return -1;
+
+    const char* nl = memchr(*p, '\n', (size_t)(end - *p));
+    if (!nl)
+        return 0;
+    if (nl == *p)
+        return -1;
+
+    char type = **p;
+    long long n = strtoll(*p + 1, NULL, 10);
+    *p = nl + 1;
+
+    switch (type)
+    {
+    case '+': case '-': case ',': case '(': case ':': case '#': case '_':
+        return 1;
+    case '$': case '=': case '!':
+        if (n < 0)
+            return 1;
+        if ((unsigned long long)(end - *p) < (unsigned long long)n + 2)
+            return 0;
+        *p += n + 2;
+        return 1;
+    case '*': case '>': case '~': case '%': case '|':
+        if (n < 0)
+            return 1;
+        for (long long i = 0; i < n * (type == '%' || type == '|' ? 2 : 1); i++)
+        {
+            int rc = scanValue(p, end, depth + 1);
+            if (rc != 1)
+                return rc;
+        }
+        // an attribute is followed by the value it annotates
+        return type == '|' ? scanValue(p, end, depth) : 1;
+    default:
+        return -1;
+    }
+}
+
+bool Resp3Reader_complete(const Resp3Reader_t* r)
+{
+    const char* p = r->buf + r->off;
+    return r->off < r->len && scanValue(&p, r->buf + r->len, 0) != 0;
+}
+
+void Resp3_free(Resp3Value_t* value)
+{
+    for (size_t i = 0; value->items && i < value->count; i++)
+        Resp3_free(&value->items[i]);
+    free(value->items);
+    free(value->str);
+    memset(value, 0, sizeof(*value));
+}
+
+const char* Resp3_itemString(const Resp3Value_t* value, size_t i)
+{
+    if (!value->items || i >= value->count)
+        return NULL;
+    const Resp3Value_t* item = &value->items[i];
+    return item->type == Resp3Type_BulkString || item->type == Resp3Type_SimpleString ? item->str : NULL;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Minimal buffered RESP3 reader, for connections that speak HELLO 3 and so
+// carry types (push, map, null, ...) yarl's RESP2 parser doesn't know.
+
+#define RESP3_READ_BUFFER 16384
+#define RESP3_MAX_DEPTH 8
+
+typedef enum Resp3Type
+{
+    Resp3Type_SimpleString = '+',
+    Resp3Type_Error = '-',
+    Resp3Type_Integer = ':',
+    Resp3Type_BulkString = '$',
+    Resp3Type_Array = '*',
+    Resp3Type_Push = '>',
+    Resp3Type_Map = '%',
+    Resp3Type_Set = '~',
+    Resp3Type_Null = '_',
+    Resp3Type_Boolean = '#',
+    Resp3Type_Double = ',',
+    Resp3Type_BigNumber = '(',
+    Resp3Type_Verbatim = '=',
+    Resp3Type_BulkError = '!'
+} Resp3Type_t;
+
+typedef struct Resp3Value
+{
+    Resp3Type_t type;
+    long long integer;          // Integer, Boolean
+    char* str;                  // NUL-terminated; strings, errors, doubles, big numbers
+    size_t len;
+    size_t count;               // aggregates; maps hold 2 * entries items
+    struct Resp3Value* items;
+} Resp3Value_t;
+
+typedef struct Resp3Reader
+{
+    int fd;
+    size_t off;
+    size_t len;
+    char buf[RESP3_READ_BUFFER];
+} Resp3Reader_t;
+
+void Resp3Reader_init(Resp3Reader_t* reader, int fd);
+
+// True if a value may be readable without touching the socket, which poll()
+// can't see.
+static inline bool Resp3Reader_buffered(const Resp3Reader_t* reader)
+{
+    return reader->off < reader->len;
+}
+
+// Blocks for one complete value (attributes are skipped). False on a
+// connection or protocol error.
+bool Resp3_read(Resp3Reader_t* reader, Resp3Value_t* out);
+
+// For readers sharing a poll() loop: takes whatever the socket has without
+// blocking, and Resp3Reader_complete says whether Resp3_read can then return
+// a value without waiting for the rest of it. receive is false if the
+// connection closed or failed; full means a value too big for the buffer is
+// pending, which only a blocking Resp3_read can take.
+bool Resp3Reader_receive(Resp3Reader_t* reader);
+bool Resp3Reader_complete(const Resp3Reader_t* reader);
+
+static inline bool Resp3Reader_full(const Resp3Reader_t* reader)
+{
+    return reader->off == 0 && reader->len == sizeof(reader->buf);
+}
+
+void Resp3_free(Resp3Value_t* value);
+
+// items[i] as a string if it is a simple/bulk string, else NULL.
+const char* Resp3_itemString(const Resp3Value_t* value, size_t i);
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rollup.h"
+
+static const uint32_t resolutionSeconds[RollupResolution_Count] = { 1, 60, 3600 };
+static const char* resolutionNames[RollupResolution_Count] = { "1s", "1m", "1h" };
+
+bool Rollup_init(RollupStore_t* store, uint32_t slots1s, uint32_t slots1m, uint32_t slots1h)
+{
+    const uint32_t slotCounts[RollupResolution_Count] = { slots1s, slots1m, slots1h };
+    RollupBucket_t* all = (RollupBucket_t*)calloc((size_t)slots1s + slots1m + slots1h, sizeof(RollupBucket_t));
+    if (!all)
+        return false;
+
+    for (int r = 0; r < RollupResolution_Count; r++)
+    {
+        store->series[r].slots = all;
+        store->series[r].slotCount = slotCounts[r];
+        store->series[r].seconds = resolutionSeconds[r];
+        // index 0 is never live once t > 0, so zeroed slots read as empty
+        all += slotCounts[r];
+    }
+
+    store->now = 0;
+    pthread_mutex_init(&store->lock, NULL);
+    return true;
+}
+
+void Rollup_record(RollupStore_t* store, uint32_t t, uint32_t value)
+{
+    pthread_mutex_lock(&store->lock);
+    for (int r = 0; r < RollupResolution_Count; r++)
+    {
+        RollupSeries_t* s = &store->series[r];
+        uint32_t index = t / s->seconds + 1;
+        RollupBucket_t* b = &s->slots[index % s->slotCount];
+
+        if (b->index != index)
+        {
+            b->index = index;
+            b->min = b->max = value;
+            b->count = 0;
+            b->sum = 0;
+        }
+
+        if (value < b->min)
+            b->min = value;
+        if (value > b->max)
+            b->max = value;
+        b->count++;
+        b->sum += value;
+    }
+    store->now = t;
+    pthread_mutex_unlock(&store->lock);
+}
+
+RollupResolution_t Rollup_parseResolution(const char* str)
+{
+    for (int r = 0; r < RollupResolution_Count; r++)
+        if (!strcmp(str, resolutionNames[r]))
+            return (RollupResolution_t)r;
+    return RollupResolution_Count;
+}
+
+int Rollup_query(RollupStore_t* store, RollupResolution_t res, uint32_t fromAgo, uint32_t toAgo,
+    char* out, size_t outLen)
+{
+    if (res >= RollupResolution_Count || fromAgo < toAgo || fromAgo - toAgo >= ROLLUP_QUERY_MAX_BUCKETS || !outLen)
+        return -1;
+
+    RollupSeries_t* s = &store->series[res];
+    if (fromAgo >= s->slotCount)
+        return -1;
+
+    size_t off = 0;
+    out[0] = '\0';
+
+    pthread_mutex_lock(&store->lock);
+    uint32_t current = store->now / s->seconds + 1;
+    for (uint32_t ago = fromAgo; off < outLen; ago--)
+    {
+        int w;
+        const RollupBucket_t* b = current > ago ? &s->slots[(current - ago) % s->slotCount] : NULL;
+
+        if (b && b->index == current - ago && b->count)
+            w = snprintf(out + off, outLen - off, "%s-%u:%u/%u/%.2f/%u", off ? " " : "",
+                ago, b->min, b->max, (double)b->sum / b->count, b->count);
+        else
+            w = snprintf(out + off, outLen - off, "%s-%u:-", off ? " " : "", ago);
+
+        off += (size_t)w;
+        if (ago == toAgo)
+            break;
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    return off < outLen ? (int)off : (int)outLen - 1;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Fixed-memory min/max/avg/count rollups of a per-second sample (the message
+// rate), kept at 1s, 1m and 1h resolution in circular arrays. All memory is
+// allocated by Rollup_init(); its size is ROLLUP_MEMORY_BYTES(s, m, h).
+
+#define ROLLUP_1S_SLOTS 300  // 5 minutes
+#define ROLLUP_1M_SLOTS 120  // 2 hours
+#define ROLLUP_1H_SLOTS 48   // 2 days
+#define ROLLUP_QUERY_MAX_BUCKETS 60
+
+typedef struct RollupBucket
+{
+    uint32_t index;     // absolute bucket number (time / resolution) this slot holds
+    uint32_t min;
+    uint32_t max;
+    uint32_t count;
+    uint64_t sum;
+} RollupBucket_t;
+
+typedef enum RollupResolution
+{
+    RollupResolution_Second = 0,
+    RollupResolution_Minute,
+    RollupResolution_Hour,
+    RollupResolution_Count
+} RollupResolution_t;
+
+typedef struct RollupSeries
+{
+    RollupBucket_t* slots;
+    uint32_t slotCount;
+    uint32_t seconds;
+} RollupSeries_t;
+
+typedef struct RollupStore
+{
+    RollupSeries_t series[RollupResolution_Count];
+    uint32_t now;       // last recorded second
+    pthread_mutex_t lock;
+} RollupStore_t;
+
+#define ROLLUP_MEMORY_BYTES(s, m, h) (((size_t)(s) + (m) + (h)) * sizeof(RollupBucket_t))
+
+// Allocates the circular arrays; returns false on allocation failure.
+bool Rollup_init(RollupStore_t* store, uint32_t slots1s, uint32_t slots1m, uint32_t slots1h);
+
+// Records one sample for second t (monotonic); samples within a second accumulate.
+void Rollup_record(RollupStore_t* store, uint32_t t, uint32_t value);
+
+// Parses "1s", "1m" or "1h"; returns RollupResolution_Count if unrecognized.
+RollupResolution_t Rollup_parseResolution(const char* str);
+
+// Formats buckets fromAgo..toAgo (in units of res, 0 = current) as
+// "ago:min/max/avg/count" entries, or "ago:-" for buckets with no samples.
+// Returns the number of bytes written, or -1 if the range is invalid.
+int Rollup_query(RollupStore_t* store, RollupResolution_t res, uint32_t fromAgo, uint32_t toAgo,
+    char* out, size_t outLen);
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "schedule.h"
+#include "shutdown.h"
+
+static uint64_t nowUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+void Schedule_init(Schedule_t* s)
+{
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_init(&s->lock, NULL);
+    s->deadlineUs = s->startedUs = nowUs();
+    s->runs = 1;
+}
+
+bool Schedule_wait(Schedule_t* s, uint32_t periodMs)
+{
+    uint64_t now = nowUs();
+
+    pthread_mutex_lock(&s->lock);
+    uint32_t ranUs = (uint32_t)(now - s->startedUs);
+    s->runLastUs = ranUs;
+    if (ranUs > s->runMaxUs)
+        s->runMaxUs = ranUs;
+
+    s->periodMs = periodMs;
+    uint64_t deadline = s->deadlineUs + (uint64_t)periodMs * 1000;
+    if (deadline <= now)
+    {
+        s->overruns++;
+        deadline = now;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    // rounded up: waking a little late is jitter, waking early isn't a deadline
+    if (deadline > now && !Shutdown_sleep((uint32_t)((deadline - now + 999) / 1000)))
+        return false;
+
+    uint64_t woke = nowUs();
+    uint32_t late = woke > deadline ? (uint32_t)(woke - deadline) : 0;
+
+    pthread_mutex_lock(&s->lock);
+    s->deadlineUs = deadline;
+    s->startedUs = woke;
+    s->runs++;
+    s->lateSamples++;
+    s->lateTotalUs += late;
+    s->lateLastUs = late;
+    if (late > s->lateMaxUs)
+        s->lateMaxUs = late;
+    pthread_mutex_unlock(&s->lock);
+    return true;
+}
+
+size_t Schedule_format(Schedule_t* s, char* buf, size_t bufLen)
+{
+    pthread_mutex_lock(&s->lock);
+    int n = snprintf(buf, bufLen,
+        "runs=%llu period=%ums late last/avg/max=%.2f/%.2f/%.2fms overruns=%llu run last/max=%.1f/%.1fms",
+        (unsigned long long)s->runs, s->periodMs, s->lateLastUs / 1e3,
+        s->lateSamples ? s->lateTotalUs / 1e3 / s->lateSamples : 0.0, s->lateMaxUs / 1e3,
+        (unsigned long long)s->overruns, s->runLastUs / 1e3, s->runMaxUs / 1e3);
+    pthread_mutex_unlock(&s->lock);
+    return n < 0 ? 0 : (size_t)n < bufLen ? (size_t)n : bufLen - 1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Deadline-based cadence for the key sweep. Each deadline is the previous
+// one plus the period, not "now plus the period", so time spent sweeping
+// doesn't push the cadence out. A sweep that runs past its next deadline
+// counts as an overrun and the next one starts at once, re-anchoring the
+// deadlines there. How late each sweep starts against its deadline (the
+// cadence jitter) and how long each takes are kept for the sweep-stats
+// command.
+
+typedef struct Schedule
+{
+    pthread_mutex_t lock;
+    uint64_t deadlineUs;            // of the run in progress
+    uint64_t startedUs;
+    uint32_t periodMs;
+    uint64_t runs;
+    uint64_t overruns;
+    uint64_t lateSamples;
+    uint64_t lateTotalUs;
+    uint32_t lateLastUs;
+    uint32_t lateMaxUs;
+    uint32_t runLastUs;
+    uint32_t runMaxUs;
+} Schedule_t;
+
+// The first run starts now.
+void Schedule_init(Schedule_t* s);
+
+// Ends the current run and sleeps until the next deadline, periodMs after
+// the last one. False if woken by a shutdown request (see shutdown.h).
+bool Schedule_wait(Schedule_t* s, uint32_t periodMs);
+
+// "runs=N period=Nms late last/avg/max=X/Y/Zms overruns=N run last/max=X/Yms"
+size_t Schedule_format(Schedule_t* s, char* buf, size_t bufLen);
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sentinel.h"
+#include "config.h"
+#include "connect.h"
+#include "resp.h"
+#include "sockprofile.h"
+#include "shutdown.h"
+
+#define SENTINEL_REPLY_TIMEOUT_SECONDS 2
+#define SENTINEL_RETRY_SECONDS 1
+
+// the runtime command profile, so socket-profile changes reach sentinel
+// links too; keepalive matters most on the watcher's long idle subscription
+static int connectSentinel(const SentinelAddr_t* sentinel)
+{
+    int conn = Connect_open(sentinel->host, sentinel->port);
+    if (conn > 0)
+    {
+        Config_t cfg;
+        Config_copy(&cfg);
+        SocketProfile_apply(conn, &cfg.socketProfiles[SocketRole_Command]);
+    }
+    return conn;
+}
+
+static bool splitHostPort(const char* s, size_t len, SentinelAddr_t* out)
+{
+    // the last colon splits, so bare IPv6 addresses still parse
+    const char* colon = NULL;
+    for (size_t i = 0; i < len; i++)
+        if (s[i] == ':')
+            colon = s + i;
+
+    if (!colon || colon == s || (size_t)(colon - s) >= sizeof(out->host)
+        || len - (size_t)(colon - s) - 1 >= sizeof(out->port) || colon == s + len - 1)
+        return false;
+
+    memcpy(out->host, s, (size_t)(colon - s));
+    out->host[colon - s] = '\0';
+    memcpy(out->port, colon + 1, len - (size_t)(colon - s) - 1);
+    out->port[len - (size_t)(colon - s) - 1] = '\0';
+    return true;
+}
+
+bool Sentinel_isSpec(const char* host)
+{
+    return !strncmp(host, SENTINEL_PREFIX, strlen(SENTINEL_PREFIX));
+}
+
+bool Sentinel_init(Sentinel_t* s, const char* spec, const char* sentinelList, volatile sig_atomic_t* running)
+{
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_init(&s->lock, NULL);
+    s->running = running;
+    for (int i = 0; i < SENTINEL_MAX_TRACKED; i++)
+        s->tracked[i] = -1;
+
+    const char* name = spec + strlen(SENTINEL_PREFIX);
+    if (!Sentinel_isSpec(spec) || !*name || strlen(name) >= sizeof(s->masterName))
+        return false;
+    strcpy(s->masterName, name);
+
+    for (const char* p = sentinelList; *p && s->sentinelCount < SENTINEL_MAX_SENTINELS; )
+    {
+        size_t len = strcspn(p, ",");
+        if (!splitHostPort(p, len, &s->sentinels[s->sentinelCount++]))
+            return false;
+        p += len + (p[len] == ',');
+    }
+    return s->sentinelCount > 0;
+}
+
+// SENTINEL get-master-addr-by-name on an open sentinel connection
+static bool queryPrimary(Sentinel_t* s, RedisConnection_t conn, SentinelAddr_t* out)
+{
+    const char* argv[] = { "SENTINEL", "get-master-addr-by-name", s->masterName };
+    if (!Resp_sendCommand(conn, 3, argv, NULL))
+        return false;
+
+    RedisObject_t reply = RedisConnection_getNextObject(conn);
+    RedisArray_t* arr = (RedisArray_t*)reply.obj;
+    bool ok = reply.type == RedisObjectType_Array && arr && arr->count == 2
+        && arr->objects[0].type == RedisObjectType_BulkString && arr->objects[0].obj
+        && arr->objects[1].type == RedisObjectType_BulkString && arr->objects[1].obj
+        && strlen((char*)arr->objects[0].obj) < sizeof(out->host)
+        && strlen((char*)arr->objects[1].obj) < sizeof(out->port);
+    if (ok)
+    {
+        strcpy(out->host, (char*)arr->objects[0].obj);
+        strcpy(out->port, (char*)arr->objects[1].obj);
+    }
+    RedisObject_dealloc(reply);
+    return ok;
+}
+
+// compared as resolved addresses: sentinels may name the primary by hostname,
+// and a dual-stack socket reports an IPv4 peer as v4-mapped
+static bool peerIn(int fd, const ConnectPeer_t* addrs, size_t count)
+{
+    ConnectPeer_t peer;
+    if (!Connect_peerOf(fd, &peer))
+        return false;
+    for (size_t i = 0; i < count; i++)
+        if (peer.port == addrs[i].port && !memcmp(&peer.addr, &addrs[i].addr, sizeof(peer.addr)))
+            return true;
+    return false;
+}
+
+// swaps in the new primary and cuts every connection still on the old one;
+// their owners see a dead socket on their next read and reconnect
+static void switchPrimary(Sentinel_t* s, const SentinelAddr_t* next)
+{
+    pthread_mutex_lock(&s->lock);
+    if (!strcmp(s->primary.host, next->host) && !strcmp(s->primary.port, next->port))
+    {
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+    SentinelAddr_t old = s->primary;
+    s->primary = *next;
+    pthread_mutex_unlock(&s->lock);
+
+    // resolved outside the lock; nothing is tracked before the first primary
+    ConnectPeer_t oldAddrs[CONNECT_MAX_CANDIDATES];
+    size_t oldCount = old.host[0] ? Connect_lookupPeers(old.host, old.port, oldAddrs) : 0;
+
+    int cut = 0;
+    pthread_mutex_lock(&s->lock);
+    for (int i = 0; i < SENTINEL_MAX_TRACKED; i++)
+    {
+        // owners untrack before closing, so every tracked fd is still theirs
+        if (s->tracked[i] >= 0 && peerIn(s->tracked[i], oldAddrs, oldCount))
+        {
+            shutdown(s->tracked[i], SHUT_RDWR);
+            s->tracked[i] = -1;
+            cut++;
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    atomic_fetch_add(&s->switches, 1);
+    printf("primary moved %s:%s -> %s:%s, cut %d connections\n", old.host, old.port, next->host, next->port, cut);
+    fflush(stdout);
+}
+
+static size_t currentSentinel(Sentinel_t* s)
+{
+    pthread_mutex_lock(&s->lock);
+    size_t current = s->current;
+    pthread_mutex_unlock(&s->lock);
+    return current;
+}
+
+// moves on from the sentinel at failed, unless another caller already has
+static void nextSentinel(Sentinel_t* s, size_t failed)
+{
+    pthread_mutex_lock(&s->lock);
+    if (s->current == failed)
+        s->current = (failed + 1) % s->sentinelCount;
+    pthread_mutex_unlock(&s->lock);
+}
+
+bool Sentinel_discover(Sentinel_t* s)
+{
+    size_t first = currentSentinel(s);
+    for (size_t i = 0; i < s->sentinelCount; i++)
+    {
+        const SentinelAddr_t* sentinel = &s->sentinels[(first + i) % s->sentinelCount];
+        int conn = connectSentinel(sentinel);
+        if (conn < 1)
+            continue;
+
+        SentinelAddr_t found;
+        Resp_setReplyTimeout(conn, SENTINEL_REPLY_TIMEOUT_SECONDS);
+        bool ok = queryPrimary(s, conn, &found);
+        close(conn);
+        if (ok)
+        {
+            switchPrimary(s, &found);
+            return true;
+        }
+        fprintf(stderr, "sentinel %s:%s doesn't know '%s'\n", sentinel->host, sentinel->port, s->masterName);
+    }
+    return false;
+}
+
+// "+switch-master" payload: <name> <old-ip> <old-port> <new-ip> <new-port>
+static bool parseSwitch(Sentinel_t* s, const char* payload, SentinelAddr_t* next)
+{
+    char name[SENTINEL_NAME_LEN], oldHost[SENTINEL_HOST_LEN], oldPort[SENTINEL_PORT_LEN];
+    return sscanf(payload, "%63s %255s %15s %255s %15s", name, oldHost, oldPort, next->host, next->port) == 5
+        && !strcmp(name, s->masterName);
+}
+
+static void* watcherFunc(void* arg)
+{
+    Sentinel_t* s = (Sentinel_t*)arg;
+    while (*s->running)
+    {
+        size_t current = currentSentinel(s);
+        const SentinelAddr_t* sentinel = &s->sentinels[current];
+        int conn = connectSentinel(sentinel);
+        const char* sub[] = { "SUBSCRIBE", "+switch-master" };
+        if (conn < 1 || !Resp_sendCommand(conn, 2, sub, NULL))
+        {
+            if (conn > 0)
+                close(conn);
+            nextSentinel(s, current);
+            Shutdown_sleep(SENTINEL_RETRY_SECONDS * 1000);
+            continue;
+        }
+        Shutdown_track(conn);
+
+        // subscribed first, so a switch between the query and now can't be missed
+        Sentinel_discover(s);
+        printf("watching sentinel %s:%s for '%s' failovers\n", sentinel->host, sentinel->port, s->masterName);
+
+        while (*s->running)
+        {
+            RedisObject_t msg = RedisConnection_getNextObject(conn);
+            if (msg.type == RedisObjectType_Invalid)
+            {
+                RedisObject_dealloc(msg);
+                break;
+            }
+
+            RedisArray_t* arr = (RedisArray_t*)msg.obj;
+            SentinelAddr_t next;
+            if (msg.type == RedisObjectType_Array && arr && arr->count == 3
+                && arr->objects[2].type == RedisObjectType_BulkString && arr->objects[2].obj
+                && parseSwitch(s, (char*)arr->objects[2].obj, &next))
+                switchPrimary(s, &next);
+            RedisObject_dealloc(msg);
+        }
+
+        Shutdown_untrack(conn);
+        close(conn);
+        if (!*s->running)
+            break;
+        fprintf(stderr, "lost sentinel %s:%s, trying the next\n", sentinel->host, sentinel->port);
+        nextSentinel(s, current);
+    }
+    return NULL;
+}
+
+bool Sentinel_start(Sentinel_t* s)
+{
+    return !pthread_create(&s->watcher, NULL, watcherFunc, s);
+}
+
+void Sentinel_stop(Sentinel_t* s)
+{
+    pthread_join(s->watcher, NULL);
+}
+
+void Sentinel_primary(Sentinel_t* s, SentinelAddr_t* out)
+{
+    pthread_mutex_lock(&s->lock);
+    *out = s->primary;
+    pthread_mutex_unlock(&s->lock);
+}
+
+void Sentinel_track(Sentinel_t* s, RedisConnection_t conn)
+{
+    pthread_mutex_lock(&s->lock);
+    int slot = -1;
+    for (int i = 0; i < SENTINEL_MAX_TRACKED && slot < 0; i++)
+        if (s->tracked[i] == conn || s->tracked[i] < 0)
+            slot = i;
+    if (slot >= 0)
+        s->tracked[slot] = conn;
+    pthread_mutex_unlock(&s->lock);
+
+    if (slot < 0)
+        fprintf(stderr, "sentinel: can't track connection %d, it won't be cut on failover\n", conn);
+}
+
+void Sentinel_untrack(Sentinel_t* s, RedisConnection_t conn)
+{
+    pthread_mutex_lock(&s->lock);
+    for (int i = 0; i < SENTINEL_MAX_TRACKED; i++)
+        if (s->tracked[i] == conn)
+            s->tracked[i] = -1;
+    pthread_mutex_unlock(&s->lock);
+}
+
+bool Sentinel_isPrimary(RedisConnection_t conn)
+{
+    const char* argv[] = { "ROLE" };
+    if (!Resp_sendCommand(conn, 1, argv, NULL))
+        return false;
+
+    RedisObject_t reply = RedisConnection_getNextObject(conn);
+    RedisArray_t* arr = (RedisArray_t*)reply.obj;
+    bool ok = reply.type == RedisObjectType_Array && arr && arr->count > 0
+        && arr->objects[0].type == RedisObjectType_BulkString && arr->objects[0].obj
+        && !strcmp((char*)arr->objects[0].obj, "master");
+    RedisObject_dealloc(reply);
+    return ok;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include <yarl.h>
+
+// Sentinel mode: instead of a fixed host and port, spheremon is given a
+// master name and a list of sentinels, e.g.
+//   spheremon sentinel:mymaster 10.0.0.5:26379,10.0.0.6:26379 [password] [device-id]
+// (every sentinel must also be in app_manifest.json AllowedConnections).
+// The primary's address is asked of the sentinels in turn, and a watcher
+// thread stays subscribed to +switch-master on one of them. When the primary
+// moves, the address is swapped and every tracked connection to the old
+// primary is shut down, so each owner's reconnect path lands on the new
+// primary straight away instead of waiting to notice the old one is gone.
+
+#define SENTINEL_PREFIX "sentinel:"
+#define SENTINEL_MAX_SENTINELS 4
+#define SENTINEL_MAX_TRACKED 16
+#define SENTINEL_HOST_LEN 256
+#define SENTINEL_PORT_LEN 16
+#define SENTINEL_NAME_LEN 64
+
+typedef struct SentinelAddr
+{
+    char host[SENTINEL_HOST_LEN];
+    char port[SENTINEL_PORT_LEN];
+} SentinelAddr_t;
+
+typedef struct Sentinel
+{
+    char masterName[SENTINEL_NAME_LEN];
+    SentinelAddr_t sentinels[SENTINEL_MAX_SENTINELS];
+    size_t sentinelCount;
+    pthread_mutex_t lock;           // guards current, primary and tracked
+    size_t current;                 // sentinel the watcher last used
+    SentinelAddr_t primary;
+    int tracked[SENTINEL_MAX_TRACKED];
+    _Atomic uint64_t switches;
+    volatile sig_atomic_t* running;
+    pthread_t watcher;
+} Sentinel_t;
+
+// True if host names sentinel mode (see SENTINEL_PREFIX).
+bool Sentinel_isSpec(const char* host);
+
+// Parses "sentinel:<name>" and "h1:p1,h2:p2"; false if malformed.
+bool Sentinel_init(Sentinel_t* s, const char* spec, const char* sentinelList, volatile sig_atomic_t* running);
+
+// Asks each sentinel in turn for the primary; false if none answered.
+bool Sentinel_discover(Sentinel_t* s);
+
+// Starts the +switch-master watcher thread.
+bool Sentinel_start(Sentinel_t* s);
+
+// Joins the watcher once running is cleared; its subscription is tracked
+// for shutdown (see shutdown.h), so this doesn't wait on a quiet sentinel.
+void Sentinel_stop(Sentinel_t* s);
+
+void Sentinel_primary(Sentinel_t* s, SentinelAddr_t* out);
+
+// Remembers conn so it's shut down if the primary moves. The owner untracks
+// before closing it, so a recycled fd number is never cut.
+void Sentinel_track(Sentinel_t* s, RedisConnection_t conn);
+void Sentinel_untrack(Sentinel_t* s, RedisConnection_t conn);
+
+// ROLE check for a fresh connection: sentinels can briefly hand out a
+// demoted primary during a failover.
+bool Sentinel_isPrimary(RedisConnection_t conn);
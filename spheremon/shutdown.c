@@ -0,0 +1,109 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "shutdown.h"
+
+static volatile sig_atomic_t* runningFlag;
+static volatile sig_atomic_t requested;
+static int wakeFd = -1;
+static struct timespec requestedAt;
+
+static pthread_mutex_t trackedLock = PTHREAD_MUTEX_INITIALIZER;
+static int tracked[SHUTDOWN_MAX_TRACKED];
+static int trackedCount;
+static bool cut;
+
+bool Shutdown_init(volatile sig_atomic_t* running)
+{
+    runningFlag = running;
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return wakeFd >= 0;
+}
+
+void Shutdown_request(void)
+{
+    // async-signal-safe calls and plain stores only: this runs in signal handlers
+    int savedErrno = errno;
+    if (!requested)
+        clock_gettime(CLOCK_MONOTONIC, &requestedAt);
+    requested = true;
+    if (runningFlag)
+        *runningFlag = false;
+    uint64_t one = 1;
+    if (wakeFd >= 0)
+        (void)!write(wakeFd, &one, sizeof(one));
+    errno = savedErrno;
+}
+
+bool Shutdown_requested(void)
+{
+    return requested;
+}
+
+uint32_t Shutdown_elapsedMs(void)
+{
+    if (!requested)
+        return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - requestedAt.tv_sec) * 1000 + (now.tv_nsec - requestedAt.tv_nsec) / 1000000);
+}
+
+int Shutdown_fd(void)
+{
+    return wakeFd;
+}
+
+bool Shutdown_sleep(uint32_t ms)
+{
+    // the eventfd is never read, so once written every poll returns at once
+    struct pollfd pfd = { .fd = wakeFd, .events = POLLIN };
+    int rc;
+    do
+        rc = poll(&pfd, 1, (int)ms);
+    while (rc < 0 && errno == EINTR && !requested);
+    return !requested;
+}
+
+void Shutdown_track(int fd)
+{
+    if (fd < 0)
+        return;
+
+    pthread_mutex_lock(&trackedLock);
+    if (cut)
+        shutdown(fd, SHUT_RDWR);
+    else if (trackedCount < SHUTDOWN_MAX_TRACKED)
+        tracked[trackedCount++] = fd;
+    pthread_mutex_unlock(&trackedLock);
+}
+
+void Shutdown_untrack(int fd)
+{
+    pthread_mutex_lock(&trackedLock);
+    for (int i = 0; i < trackedCount; i++)
+    {
+        if (tracked[i] == fd)
+        {
+            tracked[i] = tracked[--trackedCount];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&trackedLock);
+}
+
+int Shutdown_cutTracked(void)
+{
+    pthread_mutex_lock(&trackedLock);
+    cut = true;
+    int count = trackedCount;
+    for (int i = 0; i < trackedCount; i++)
+        shutdown(tracked[i], SHUT_RDWR);
+    pthread_mutex_unlock(&trackedLock);
+    return count;
+}
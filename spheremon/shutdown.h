@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+
+// Prompt shutdown. Clearing running alone leaves threads asleep or blocked in
+// a socket read until their next message, which on a quiet channel is never.
+// Shutdown_request clears running and signals an eventfd; sleepers wait on
+// that eventfd (Shutdown_sleep, or poll on Shutdown_fd) instead of
+// nanosleep, and sockets a thread blocks reading on are tracked so
+// Shutdown_cutTracked can shut them down and fail the read. The request is
+// async-signal-safe; cutting is not, so the main thread does it once its own
+// sleep is woken.
+
+#define SHUTDOWN_MAX_TRACKED 16
+
+// Creates the eventfd; running is what Shutdown_request clears.
+bool Shutdown_init(volatile sig_atomic_t* running);
+
+// Async-signal-safe.
+void Shutdown_request(void);
+
+bool Shutdown_requested(void);
+
+// Time since the first request, for reporting how long shutdown took.
+uint32_t Shutdown_elapsedMs(void);
+
+// Readable once shutdown has been requested, for poll() sets.
+int Shutdown_fd(void);
+
+// Sleeps up to ms; false if woken early by a shutdown request.
+bool Shutdown_sleep(uint32_t ms);
+
+// fd is blocked on by its owner; a socket tracked after the cut is cut at
+// once. The owner untracks before closing.
+void Shutdown_track(int fd);
+void Shutdown_untrack(int fd);
+
+// shutdown(SHUT_RDWR) on every tracked socket; returns how many. Sockets
+// are only tracked once connected: a thread inside Connect_open, racing
+// attempts that haven't completed, isn't woken, and holds shutdown up for
+// at most CONNECT_ATTEMPT_TIMEOUT_MS (3 s) per attempt still in flight.
+int Shutdown_cutTracked(void);
@@ -0,0 +1,92 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "sockprofile.h"
+
+static const char* roleNames[SocketRole_Count] = { "subscriber", "sweep", "command", "reply" };
+
+static bool setInt(int fd, int level, int name, const char* label, int value)
+{
+    if (!setsockopt(fd, level, name, &value, sizeof(value)))
+        return true;
+
+    fprintf(stderr, "setsockopt %s=%d: %s\n", label, value, strerror(errno));
+    return false;
+}
+
+bool SocketProfile_apply(int fd, const SocketProfile_t* profile)
+{
+    bool ok = setInt(fd, IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY", profile->noDelay);
+
+    ok &= setInt(fd, SOL_SOCKET, SO_KEEPALIVE, "SO_KEEPALIVE", profile->keepIdle != 0);
+    if (profile->keepIdle)
+    {
+        ok &= setInt(fd, IPPROTO_TCP, TCP_KEEPIDLE, "TCP_KEEPIDLE", (int)profile->keepIdle);
+        ok &= setInt(fd, IPPROTO_TCP, TCP_KEEPINTVL, "TCP_KEEPINTVL", (int)profile->keepInterval);
+        ok &= setInt(fd, IPPROTO_TCP, TCP_KEEPCNT, "TCP_KEEPCNT", (int)profile->keepCount);
+    }
+
+    // Linux picks the window scale from its sysctl maximums rather than the
+    // buffer size at SYN time, so setting these after connect still works
+    if (profile->rcvBuf)
+        ok &= setInt(fd, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", (int)profile->rcvBuf);
+    if (profile->sndBuf)
+        ok &= setInt(fd, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", (int)profile->sndBuf);
+
+#ifdef SO_BUSY_POLL
+    if (profile->busyPollUs)
+        ok &= setInt(fd, SOL_SOCKET, SO_BUSY_POLL, "SO_BUSY_POLL", (int)profile->busyPollUs);
+#endif
+    return ok;
+}
+
+bool SocketProfile_parseRole(const char* name, SocketRole_t* role)
+{
+    for (int i = 0; i < SocketRole_Count; i++)
+    {
+        if (!strcmp(name, roleNames[i]))
+        {
+            *role = (SocketRole_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* SocketProfile_roleName(SocketRole_t role)
+{
+    return role < SocketRole_Count ? roleNames[role] : "?";
+}
+
+bool SocketProfile_set(SocketProfile_t* profile, const char* field, uint32_t value)
+{
+    if (!strcmp(field, "nodelay"))
+        profile->noDelay = value != 0;
+    else if (!strcmp(field, "keepidle"))
+        profile->keepIdle = value;
+    else if (!strcmp(field, "keepintvl"))
+        profile->keepInterval = value;
+    else if (!strcmp(field, "keepcnt"))
+        profile->keepCount = value;
+    else if (!strcmp(field, "rcvbuf"))
+        profile->rcvBuf = value;
+    else if (!strcmp(field, "sndbuf"))
+        profile->sndBuf = value;
+    else if (!strcmp(field, "busypoll"))
+        profile->busyPollUs = value;
+    else
+        return false;
+    return true;
+}
+
+size_t SocketProfile_format(const SocketProfile_t* profile, char* buf, size_t bufLen)
+{
+    int n = snprintf(buf, bufLen, "nodelay=%d keepidle=%u keepintvl=%u keepcnt=%u rcvbuf=%u sndbuf=%u busypoll=%u",
+        profile->noDelay, profile->keepIdle, profile->keepInterval, profile->keepCount,
+        profile->rcvBuf, profile->sndBuf, profile->busyPollUs);
+    return n < 0 ? 0 : (size_t)n < bufLen ? (size_t)n : bufLen - 1;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-role socket options, applied to each connection as it's opened. They
+// live in the runtime config (see config.h), so a change takes effect on each
+// role's next connect or reconnect.
+//   subscriber: the activity PSUBSCRIBE
+//   sweep:      the key sweep's EXISTS round trips
+//   command:    command SUBSCRIBE and the command stream
+//   reply:      command replies and watch thread metrics
+// Keepalive probes after keepIdle seconds of silence, every keepInterval
+// seconds, and gives up after keepCount misses, so a dead peer is noticed in
+// about keepIdle + keepInterval * keepCount seconds rather than hours.
+// Buffer sizes of 0 leave the kernel's defaults and autotuning alone;
+// setting SO_RCVBUF/SO_SNDBUF turns autotuning off for that socket. The
+// device's default receive buffer is too small to ride out an activity
+// burst, so the subscriber gets SOCKET_SUBSCRIBER_RCVBUF there; the host
+// build (CMakeLists.txt) sets it to 0, since a desktop kernel's autotuning
+// already grows well past it. Either can be changed at runtime, e.g.
+//   socket-profile subscriber rcvbuf 0
+
+#ifndef SOCKET_SUBSCRIBER_RCVBUF
+#define SOCKET_SUBSCRIBER_RCVBUF (64 * 1024)
+#endif
+
+typedef enum SocketRole
+{
+    SocketRole_Subscriber = 0,
+    SocketRole_Sweep,
+    SocketRole_Command,
+    SocketRole_Reply,
+    SocketRole_Count
+} SocketRole_t;
+
+typedef struct SocketProfile
+{
+    bool noDelay;
+    uint32_t keepIdle;          // seconds; 0 disables keepalive
+    uint32_t keepInterval;
+    uint32_t keepCount;
+    uint32_t rcvBuf;            // bytes; 0 leaves the kernel autotuning it
+    uint32_t sndBuf;
+    uint32_t busyPollUs;        // 0 disables; needs kernel support
+} SocketProfile_t;
+
+#define SOCKET_PROFILE_DEFAULTS { \
+    [SocketRole_Subscriber] = { true, 30, 10, 3, SOCKET_SUBSCRIBER_RCVBUF, 0, 0 }, \
+    [SocketRole_Sweep]      = { true, 60, 10, 3, 0, 0, 0 }, \
+    [SocketRole_Command]    = { true, 30, 10, 3, 0, 0, 0 }, \
+    [SocketRole_Reply]      = { true, 60, 10, 3, 0, 0, 0 } }
+
+// Applies every option it can; returns false if any was refused (logged).
+bool SocketProfile_apply(int fd, const SocketProfile_t* profile);
+
+bool SocketProfile_parseRole(const char* name, SocketRole_t* role);
+const char* SocketProfile_roleName(SocketRole_t role);
+
+// Sets one field by name ("nodelay", "keepidle", "keepintvl", "keepcnt",
+// "rcvbuf", "sndbuf", "busypoll"); false if there's no such field.
+bool SocketProfile_set(SocketProfile_t* profile, const char* field, uint32_t value);
+
+size_t SocketProfile_format(const SocketProfile_t* profile, char* buf, size_t bufLen);
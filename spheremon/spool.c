@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "spool.h"
+
+static uint8_t byteAt(const Spool_t* spool, size_t off)
+{
+    return spool->buf[(spool->head + off) % SPOOL_BYTES];
+}
+
+static void evictOldest(Spool_t* spool)
+{
+    size_t recLen = 1 + byteAt(spool, 0);
+    spool->head = (spool->head + recLen) % SPOOL_BYTES;
+    spool->used -= recLen;
+    spool->count--;
+}
+
+void Spool_init(Spool_t* spool)
+{
+    spool->head = spool->used = spool->count = 0;
+    spool->evicted = 0;
+}
+
+bool Spool_push(Spool_t* spool, const void* data, size_t len)
+{
+    if (len > SPOOL_MAX_RECORD)
+        return false;
+
+    while (SPOOL_BYTES - spool->used < len + 1)
+    {
+        evictOldest(spool);
+        spool->evicted++;
+    }
+
+    size_t tail = (spool->head + spool->used) % SPOOL_BYTES;
+    spool->buf[tail] = (uint8_t)len;
+    tail = (tail + 1) % SPOOL_BYTES;
+
+    size_t first = len < SPOOL_BYTES - tail ? len : SPOOL_BYTES - tail;
+    memcpy(spool->buf + tail, data, first);
+    memcpy(spool->buf, (const uint8_t*)data + first, len - first);
+
+    spool->used += len + 1;
+    spool->count++;
+    return true;
+}
+
+size_t Spool_peek(const Spool_t* spool, uint8_t* scratch, size_t scratchLen,
+    const char** recs, size_t* lens, size_t maxRecs)
+{
+    size_t n = 0, off = 0, out = 0;
+    while (n < maxRecs && n < spool->count)
+    {
+        size_t len = byteAt(spool, off);
+        if (out + len > scratchLen)
+            break;
+
+        for (size_t i = 0; i < len; i++)
+            scratch[out + i] = byteAt(spool, off + 1 + i);
+
+        recs[n] = (const char*)scratch + out;
+        lens[n++] = len;
+        out += len;
+        off += len + 1;
+    }
+    return n;
+}
+
+void Spool_drop(Spool_t* spool, size_t n)
+{
+    while (n-- && spool->count)
+        evictOldest(spool);
+}
+
+bool Spool_backfill(Spool_t* spool, RespTransport_t transport, void* ctx)
+{
+    static uint8_t scratch[SPOOL_BACKFILL_BATCH * SPOOL_MAX_RECORD];
+    static char request[SPOOL_BACKFILL_BATCH * (SPOOL_MAX_RECORD + 16) + 128];
+    const char* argv[2 + SPOOL_BACKFILL_BATCH] = { "RPUSH", SPOOL_BACKFILL_KEY };
+    size_t argvLen[2 + SPOOL_BACKFILL_BATCH] = { strlen("RPUSH"), strlen(SPOOL_BACKFILL_KEY) };
+    bool sent = false;
+
+    for (int batch = 0; batch < SPOOL_BACKFILL_BATCHES_PER_TICK && spool->count; batch++)
+    {
+        size_t n = Spool_peek(spool, scratch, sizeof(scratch), argv + 2, argvLen + 2, SPOOL_BACKFILL_BATCH);
+        size_t len = Resp_encodeCommand(request, sizeof(request), (int)n + 2, argv, argvLen);
+        if (!len || !transport(ctx, request, len, 1))
+            return false;
+
+        Spool_drop(spool, n);
+        sent = true;
+    }
+
+    if (sent)
+    {
+        char keep[16];
+        snprintf(keep, sizeof(keep), "-%d", SPOOL_BACKFILL_KEEP);
+        const char* trim[] = { "LTRIM", SPOOL_BACKFILL_KEY, keep, "-1" };
+        size_t len = Resp_encodeCommand(request, sizeof(request), 4, trim, NULL);
+        if (!transport(ctx, request, len, 1))
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "resp.h"
+
+// Bounded RAM spool of metric payloads recorded while redis is unreachable.
+// Records are length-prefixed in a fixed byte ring; when it fills, the oldest
+// records are evicted. Not thread-safe: owned by the watch thread.
+
+#define SPOOL_BYTES                 16384
+#define SPOOL_MAX_RECORD            255
+#define SPOOL_BACKFILL_KEY          "spheremon:watchthread:backfill"
+#define SPOOL_BACKFILL_KEEP         4096
+#define SPOOL_BACKFILL_BATCH        64
+#define SPOOL_BACKFILL_BATCHES_PER_TICK 4
+
+typedef struct Spool
+{
+    uint8_t buf[SPOOL_BYTES];
+    size_t head;
+    size_t used;
+    size_t count;
+    uint64_t evicted;
+} Spool_t;
+
+void Spool_init(Spool_t* spool);
+
+// Appends a record, evicting the oldest as needed; false if len > SPOOL_MAX_RECORD.
+bool Spool_push(Spool_t* spool, const void* data, size_t len);
+
+// Copies up to maxRecs of the oldest records into scratch (left in place);
+// recs/lens point into scratch. Returns the number copied.
+size_t Spool_peek(const Spool_t* spool, uint8_t* scratch, size_t scratchLen,
+    const char** recs, size_t* lens, size_t maxRecs);
+
+// Removes the n oldest records.
+void Spool_drop(Spool_t* spool, size_t n);
+
+// RPUSHes spooled records onto SPOOL_BACKFILL_KEY, at most
+// SPOOL_BACKFILL_BATCHES_PER_TICK batches of SPOOL_BACKFILL_BATCH per call so a
+// long outage is replayed gradually. Records are only dropped once redis has
+// acknowledged them. Returns false on a connection error.
+bool Spool_backfill(Spool_t* spool, RespTransport_t transport, void* ctx);
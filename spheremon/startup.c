@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "startup.h"
+
+static const char* phaseNames[StartupPhase_Count] = {
+    "gpio", "network", "dns", "keys", "activity", "command", "watch", "command-stream"
+};
+
+static uint64_t nowUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+void Startup_init(Startup_t* s)
+{
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_init(&s->lock, NULL);
+
+    // timed waits against the monotonic clock, so a clock set can't stretch them
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s->changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    s->startUs = nowUs();
+}
+
+static void mark(Startup_t* s, StartupPhase_t phase, uint32_t* set)
+{
+    pthread_mutex_lock(&s->lock);
+    // the first time sticks; threads mark themselves again after reconnects
+    if (!((s->ready | s->failed) & STARTUP_BIT(phase)))
+        s->readyMs[phase] = (uint32_t)((nowUs() - s->startUs) / 1000);
+    *set |= STARTUP_BIT(phase);
+    pthread_cond_broadcast(&s->changed);
+    pthread_mutex_unlock(&s->lock);
+}
+
+void Startup_ready(Startup_t* s, StartupPhase_t phase)
+{
+    mark(s, phase, &s->ready);
+}
+
+void Startup_fail(Startup_t* s, StartupPhase_t phase)
+{
+    mark(s, phase, &s->failed);
+}
+
+void Startup_stopped(Startup_t* s, StartupPhase_t phase)
+{
+    pthread_mutex_lock(&s->lock);
+    s->stopped |= STARTUP_BIT(phase);
+    pthread_mutex_unlock(&s->lock);
+}
+
+bool Startup_isReady(Startup_t* s, StartupPhase_t phase)
+{
+    pthread_mutex_lock(&s->lock);
+    bool ready = s->ready & STARTUP_BIT(phase);
+    pthread_mutex_unlock(&s->lock);
+    return ready;
+}
+
+bool Startup_wait(Startup_t* s, uint32_t mask, volatile sig_atomic_t* running)
+{
+    pthread_mutex_lock(&s->lock);
+    // a signal handler can clear *running but can't signal the condition,
+    // so wake up now and then to look
+    while ((s->ready & mask) != mask && !(s->failed & mask) && *running)
+    {
+        struct timespec until;
+        clock_gettime(CLOCK_MONOTONIC, &until);
+        until.tv_nsec += STARTUP_WAIT_SLICE_MS * 1000000L;
+        if (until.tv_nsec >= 1000000000L)
+        {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&s->changed, &s->lock, &until);
+    }
+    bool ok = (s->ready & mask) == mask;
+    pthread_mutex_unlock(&s->lock);
+    return ok;
+}
+
+int Startup_runningCount(Startup_t* s, uint32_t mask)
+{
+    pthread_mutex_lock(&s->lock);
+    uint32_t live = s->ready & ~s->stopped & mask;
+    pthread_mutex_unlock(&s->lock);
+
+    int count = 0;
+    for (; live; live &= live - 1)
+        count++;
+    return count;
+}
+
+size_t Startup_format(Startup_t* s, char* buf, size_t bufLen)
+{
+    pthread_mutex_lock(&s->lock);
+    size_t off = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < StartupPhase_Count && off < bufLen; i++)
+    {
+        if (s->ready & STARTUP_BIT(i))
+            off += (size_t)snprintf(buf + off, bufLen - off, "%s%s=%ums", i ? " " : "", phaseNames[i], s->readyMs[i]);
+        else
+            off += (size_t)snprintf(buf + off, bufLen - off, "%s%s=%s", i ? " " : "", phaseNames[i],
+                s->failed & STARTUP_BIT(i) ? "failed" : "-");
+    }
+    pthread_mutex_unlock(&s->lock);
+    return off < bufLen ? off : bufLen - 1;
+}
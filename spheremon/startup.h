@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+
+// Startup coordination. Each subsystem marks its phase ready (or failed) when
+// it's done, and whoever depends on it blocks on a condition variable instead
+// of spinning on a counter. Independent phases run side by side: GPIO setup
+// with the network wait, then key discovery on the main thread while the
+// activity, command, watch and command stream threads make their own
+// connections. Every phase's time-to-ready is kept, measured from
+// Startup_init, for the startup command.
+
+#define STARTUP_WAIT_SLICE_MS 100
+
+typedef enum StartupPhase
+{
+    StartupPhase_Gpio = 0,
+    StartupPhase_Network,
+    StartupPhase_Dns,
+    StartupPhase_Keys,
+    StartupPhase_Activity,
+    StartupPhase_Command,
+    StartupPhase_Watch,
+    StartupPhase_CommandStream,
+    StartupPhase_Count
+} StartupPhase_t;
+
+#define STARTUP_BIT(phase) (1u << (phase))
+#define STARTUP_THREADS (STARTUP_BIT(StartupPhase_Activity) | STARTUP_BIT(StartupPhase_Command) \
+    | STARTUP_BIT(StartupPhase_Watch) | STARTUP_BIT(StartupPhase_CommandStream))
+#define STARTUP_ALL (STARTUP_BIT(StartupPhase_Count) - 1)
+
+typedef struct Startup
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint32_t ready;                 // STARTUP_BITs
+    uint32_t failed;
+    uint32_t stopped;               // threads that were ready and have since exited
+    uint64_t startUs;
+    uint32_t readyMs[StartupPhase_Count];
+} Startup_t;
+
+void Startup_init(Startup_t* s);
+
+void Startup_ready(Startup_t* s, StartupPhase_t phase);
+void Startup_fail(Startup_t* s, StartupPhase_t phase);
+
+// A thread phase is leaving; it stays ready for the timings.
+void Startup_stopped(Startup_t* s, StartupPhase_t phase);
+
+bool Startup_isReady(Startup_t* s, StartupPhase_t phase);
+
+// Blocks until every phase in mask is ready. False if one of them failed or
+// *running was cleared first.
+bool Startup_wait(Startup_t* s, uint32_t mask, volatile sig_atomic_t* running);
+
+// Ready phases in mask that haven't stopped.
+int Startup_runningCount(Startup_t* s, uint32_t mask);
+
+// "gpio=Nms network=Nms dns=- ..." ("failed" or "-" for phases not ready)
+size_t Startup_format(Startup_t* s, char* buf, size_t bufLen);
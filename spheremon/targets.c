@@ -0,0 +1,421 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "targets.h"
+#include "connect.h"
+#include "reconnect.h"
+#include "resp.h"
+#include "sockprofile.h"
+#include "shutdown.h"
+
+#define TARGET_POLL_MS 1000
+#define TARGET_BACKOFF_BASE_MS 500
+#define TARGET_REPLY_TIMEOUT_SECONDS 3
+
+static uint64_t nowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+static uint64_t threadCpuNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+void TargetSet_init(TargetSet_t* set, volatile sig_atomic_t* running)
+{
+    memset(set, 0, sizeof(*set));
+    set->running = running;
+}
+
+static bool copyField(char* dst, size_t dstLen, const char* src, size_t len)
+{
+    if (!len || len >= dstLen)
+        return false;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return true;
+}
+
+bool TargetSet_add(TargetSet_t* set, const char* spec, const Config_t* defaults)
+{
+    if (set->count == TARGET_MAX)
+        return false;
+
+    Target_t* t = &set->targets[set->count];
+    memset(t, 0, sizeof(*t));
+
+    const char* end = spec + strcspn(spec, ";");
+    const char* eq = memchr(spec, '=', (size_t)(end - spec));
+    if (!eq)
+        return false;
+
+    const char* at = memchr(eq, '@', (size_t)(end - eq));
+    const char* addr = at ? at + 1 : eq + 1;
+    const char* colon = NULL;
+    for (const char* p = addr; p < end; p++)
+        if (*p == ':')
+            colon = p;
+
+    if (!colon
+        || !copyField(t->name, sizeof(t->name), spec, (size_t)(eq - spec))
+        || (at && !copyField(t->pass, sizeof(t->pass), eq + 1, (size_t)(at - eq - 1)))
+        || !copyField(t->host, sizeof(t->host), addr, (size_t)(colon - addr))
+        || !copyField(t->port, sizeof(t->port), colon + 1, (size_t)(end - colon - 1))
+        || TargetSet_find(set, t->name))
+        return false;
+
+    strcpy(t->subscribePattern, "*");
+    for (size_t i = 0; i < defaults->keyPatternCount; i++)
+        strcpy(t->keyPatterns[i], defaults->keyPatterns[i]);
+    t->keyPatternCount = defaults->keyPatternCount;
+
+    if (*end == ';')
+    {
+        const char* p = end + 1;
+        size_t len = strcspn(p, ";");
+        if (len && !copyField(t->subscribePattern, sizeof(t->subscribePattern), p, len))
+            return false;
+
+        // explicit key patterns replace the defaults
+        if (p[len] == ';')
+            t->keyPatternCount = 0;
+        for (p += len; *p == ';' && t->keyPatternCount < CONFIG_MAX_PATTERNS; p += len)
+        {
+            len = strcspn(++p, ";");
+            if (!copyField(t->keyPatterns[t->keyPatternCount++], CONFIG_PATTERN_LEN, p, len))
+                return false;
+        }
+    }
+
+    t->sweepConn = -1;
+    t->subConn = -1;
+    atomic_init(&t->handoff, -1);
+    KeyTable_init(&t->keys);
+    set->count++;
+    return true;
+}
+
+Target_t* TargetSet_find(TargetSet_t* set, const char* name)
+{
+    for (size_t i = 0; i < set->count; i++)
+        if (!strcmp(set->targets[i].name, name))
+            return &set->targets[i];
+    return NULL;
+}
+
+static RedisConnection_t connectTarget(Target_t* t, SocketRole_t role)
+{
+    RedisConnection_t conn = Connect_open(t->host, t->port);
+    if (conn < 1)
+        return conn;
+
+    Config_t cfg;
+    Config_copy(&cfg);
+    SocketProfile_apply(conn, &cfg.socketProfiles[role]);
+
+    if (t->pass[0] && !Redis_AUTH(conn, t->pass))
+    {
+        fprintf(stderr, "target %s: AUTH failed\n", t->name);
+        close(conn);
+        return -3;
+    }
+
+    // bounds the sweep's round trips, and the activity loop's blocking read
+    // of a message too big for its buffer, so one stalled target can't hold
+    // up every other
+    Resp_setReplyTimeout(conn, TARGET_REPLY_TIMEOUT_SECONDS);
+    return conn;
+}
+
+static void dropSweep(Target_t* t)
+{
+    if (t->sweepConn > 0)
+        close(t->sweepConn);
+    t->sweepConn = -1;
+    atomic_store(&t->sweepUp, false);
+}
+
+// brings both connections up; false (and backs off) if either is down
+static bool ensureConnected(Target_t* t, uint64_t now)
+{
+    if (t->sweepConn > 0 && atomic_load(&t->subUp))
+        return true;
+    if (now < t->retryAtMs)
+        return false;
+
+    bool ok = true;
+    if (t->sweepConn < 1)
+    {
+        ok = (t->sweepConn = connectTarget(t, SocketRole_Sweep)) > 0;
+        atomic_store(&t->sweepUp, ok);
+    }
+
+    if (ok && !atomic_load(&t->subUp) && atomic_load(&t->handoff) < 0)
+    {
+        RedisConnection_t sub = connectTarget(t, SocketRole_Subscriber);
+        const char* psub[] = { "PSUBSCRIBE", t->subscribePattern };
+        if (sub > 0 && Resp_sendCommand(sub, 2, psub, NULL))
+        {
+            atomic_store(&t->subUp, true);
+            atomic_store(&t->handoff, sub);
+        }
+        else
+        {
+            if (sub > 0)
+                close(sub);
+            ok = false;
+        }
+    }
+
+    if (ok)
+    {
+        if (t->connectedOnce)
+            atomic_fetch_add(&t->reconnects, 1);
+        t->connectedOnce = true;
+        t->backoffMs = 0;
+        return true;
+    }
+
+    t->backoffMs = t->backoffMs ? t->backoffMs * 2 : TARGET_BACKOFF_BASE_MS;
+    if (t->backoffMs > TARGET_BACKOFF_MAX_MS)
+        t->backoffMs = TARGET_BACKOFF_MAX_MS;
+    t->retryAtMs = now + t->backoffMs;
+    fprintf(stderr, "target %s unreachable, retrying in %ums\n", t->name, t->backoffMs);
+    return false;
+}
+
+static bool loadKeys(Target_t* t)
+{
+    RedisArray_t* loaded[CONFIG_MAX_PATTERNS];
+    for (size_t i = 0; i < t->keyPatternCount; i++)
+    {
+        if (!(loaded[i] = Redis_KEYS(t->sweepConn, t->keyPatterns[i])))
+        {
+            while (i--)
+                RedisArray_dealloc(loaded[i]);
+            return false;
+        }
+    }
+
+    if (!KeyTable_rebuild(&t->keys, loaded, t->keyPatternCount))
+    {
+        for (size_t i = 0; i < t->keyPatternCount; i++)
+            RedisArray_dealloc(loaded[i]);
+        return false;
+    }
+
+    for (size_t i = 0; i < t->keySetCount; i++)
+        RedisArray_dealloc(t->keySets[i]);
+    memcpy(t->keySets, loaded, t->keyPatternCount * sizeof(RedisArray_t*));
+    t->keySetCount = t->keyPatternCount;
+    printf("target %s: tracking %zu keys\n", t->name, t->keys.count);
+    return true;
+}
+
+static void sweepTarget(Target_t* t, uint64_t now, uint64_t keysGeneration)
+{
+    if (!ensureConnected(t, now))
+        return;
+
+    // same reasoning as the primary's sweep: a dead link must not read as lost keys
+    if (!Reconnect_ping(t->sweepConn))
+    {
+        dropSweep(t);
+        return;
+    }
+
+    // reload-keys (or a pattern change) re-queries targets too
+    if (!t->keysLoaded || t->keysGeneration != keysGeneration)
+    {
+        if (!loadKeys(t))
+        {
+            dropSweep(t);
+            return;
+        }
+        t->keysLoaded = true;
+        t->keysGeneration = keysGeneration;
+    }
+
+    for (size_t i = 0; i < t->keys.count && !Shutdown_requested(); i++)
+    {
+        // a false EXISTS may be a failed read; abandon the sweep rather than
+        // mark the rest lost
+        bool lost = !Redis_EXISTS(t->sweepConn, t->keys.names[i]);
+        if (lost && !Reconnect_ping(t->sweepConn))
+        {
+            fprintf(stderr, "target %s: sweep connection failed mid-sweep\n", t->name);
+            dropSweep(t);
+            return;
+        }
+        KeyTable_setLost(&t->keys, i, lost);
+    }
+}
+
+void* TargetSet_sweepFunc(void* arg)
+{
+    TargetSet_t* set = (TargetSet_t*)arg;
+
+    while (*set->running)
+    {
+        Config_t cfg;
+        Config_copy(&cfg);
+        for (size_t i = 0; i < set->count && *set->running; i++)
+        {
+            uint64_t cpu = threadCpuNs();
+            sweepTarget(&set->targets[i], nowMs(), cfg.keysGeneration);
+            atomic_fetch_add(&set->targets[i].sweepNs, threadCpuNs() - cpu);
+        }
+
+        Shutdown_sleep(cfg.keyCheckCadenceSeconds * 1000);
+    }
+
+    for (size_t i = 0; i < set->count; i++)
+        dropSweep(&set->targets[i]);
+    return NULL;
+}
+
+static void dropSubscription(Target_t* t)
+{
+    fprintf(stderr, "target %s: subscription lost\n", t->name);
+    close(t->subConn);
+    t->subConn = -1;
+    atomic_store(&t->subUp, false);
+}
+
+// takes what the socket has and parses only the complete values, so a
+// message split across segments waits in the buffer for the next poll()
+// instead of blocking every other target; false if the connection failed
+static bool readMessages(Target_t* t)
+{
+    if (!Resp3Reader_receive(t->reader))
+        return false;
+
+    while (Resp3Reader_complete(t->reader) || Resp3Reader_full(t->reader))
+    {
+        // a full buffer holds part of an oversized message; that read blocks,
+        // bounded by TARGET_REPLY_TIMEOUT_SECONDS
+        Resp3Value_t msg;
+        if (!Resp3_read(t->reader, &msg))
+            return false;
+
+        // confirmations are arrays too; only pmessages count
+        const char* kind = Resp3_itemString(&msg, 0);
+        if (msg.type == Resp3Type_Array && kind && !strcmp(kind, "pmessage"))
+            atomic_fetch_add_explicit(&t->msgCount, 1, memory_order_relaxed);
+        Resp3_free(&msg);
+    }
+    return true;
+}
+
+void* TargetSet_activityFunc(void* arg)
+{
+    TargetSet_t* set = (TargetSet_t*)arg;
+    struct pollfd pfds[TARGET_MAX + 1];
+    Target_t* polled[TARGET_MAX];
+
+    for (size_t i = 0; i < set->count; i++)
+        set->targets[i].reader = (Resp3Reader_t*)malloc(sizeof(Resp3Reader_t));
+
+    while (*set->running)
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < set->count; i++)
+        {
+            Target_t* t = &set->targets[i];
+            int fresh = atomic_exchange(&t->handoff, -1);
+            if (fresh > 0 && t->reader)
+            {
+                t->subConn = fresh;
+                Resp3Reader_init(t->reader, fresh);
+            }
+            else if (fresh > 0)
+            {
+                close(fresh);
+                atomic_store(&t->subUp, false);
+            }
+
+            if (t->subConn > 0)
+            {
+                pfds[n] = (struct pollfd){ .fd = t->subConn, .events = POLLIN };
+                polled[n++] = t;
+            }
+        }
+
+        // new subscriptions are picked up at the latest after one poll timeout;
+        // the last slot wakes the loop for shutdown
+        pfds[n] = (struct pollfd){ .fd = Shutdown_fd(), .events = POLLIN };
+        if (poll(pfds, n + 1, TARGET_POLL_MS) <= 0)
+            continue;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            if (!pfds[i].revents)
+                continue;
+
+            uint64_t cpu = threadCpuNs();
+            if (!readMessages(polled[i]))
+                dropSubscription(polled[i]);
+            atomic_fetch_add(&polled[i]->activityNs, threadCpuNs() - cpu);
+        }
+    }
+
+    for (size_t i = 0; i < set->count; i++)
+    {
+        if (set->targets[i].subConn > 0)
+            close(set->targets[i].subConn);
+        free(set->targets[i].reader);
+    }
+    return NULL;
+}
+
+// the target's share of memory: its struct, subscription buffer and key table
+static size_t targetBytes(Target_t* t)
+{
+    size_t bytes = sizeof(Target_t) + (t->reader ? sizeof(Resp3Reader_t) : 0);
+
+    pthread_rwlock_rdlock(&t->keys.lock);
+    bytes += t->keys.count * sizeof(char*) + (t->keys.count / 32 + 1) * sizeof(uint32_t);
+    for (size_t i = 0; i < t->keys.count; i++)
+        bytes += strlen(t->keys.names[i]) + 1;
+    pthread_rwlock_unlock(&t->keys.lock);
+    return bytes;
+}
+
+size_t TargetSet_format(TargetSet_t* set, char* buf, size_t bufLen)
+{
+    size_t off = 0;
+    buf[0] = '\0';
+
+    for (size_t i = 0; i < set->count && off < bufLen; i++)
+    {
+        Target_t* t = &set->targets[i];
+        off += (size_t)snprintf(buf + off, bufLen - off,
+            "%s%s %s msgs=%llu tracked=%zu lost=%zu reconnects=%u cpu=%.1fms/%.1fms mem=%zuB",
+            i ? "; " : "", t->name, atomic_load(&t->subUp) && atomic_load(&t->sweepUp) ? "up" : "down",
+            (unsigned long long)atomic_load(&t->msgCount), t->keys.count, atomic_load(&t->keys.lostCount),
+            atomic_load(&t->reconnects), atomic_load(&t->activityNs) / 1e6, atomic_load(&t->sweepNs) / 1e6,
+            targetBytes(t));
+    }
+    return off < bufLen ? off : bufLen - 1;
+}
+
+size_t Target_formatWatch(Target_t* target, uint64_t uptime, double intervalSeconds, char* buf, size_t bufLen)
+{
+    uint64_t count = atomic_load(&target->msgCount);
+    uint64_t delta = count - target->watchLast;
+    target->watchLast = count;
+
+    int n = snprintf(buf, bufLen, "[%06llu] %s %-6llu %-3llu %5.2f tracked=%zu lost=%zu",
+        (unsigned long long)uptime, target->name, (unsigned long long)count, (unsigned long long)delta,
+        delta / intervalSeconds, target->keys.count, atomic_load(&target->keys.lostCount));
+    return n < 0 ? 0 : (size_t)n < bufLen ? (size_t)n : bufLen - 1;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+
+#include <yarl.h>
+
+#include "config.h"
+#include "keytable.h"
+#include "resp3.h"
+
+// Additional redis instances watched alongside the primary one. Each target
+// has its own key sets, subscription pattern, key table and counters, but
+// all targets share two threads no matter how many there are: an activity
+// loop that poll()s every target's subscription socket, and a sweep loop
+// that (re)connects targets and checks their keys each cadence. A target is
+// given on the command line after the device id as
+//   name=[password@]host:port[;subscribe-pattern[;key-pattern...]]
+// with the subscribe pattern defaulting to "*" and the key patterns to the
+// primary's. Each thread's CPU time is charged to the target it was serving,
+// so the targets command shows what one more target costs.
+
+#define TARGET_MAX 8
+#define TARGET_NAME_LEN 32
+#define TARGET_HOST_LEN 128
+#define TARGET_PORT_LEN 16
+#define TARGET_PASS_LEN 64
+#define TARGET_BACKOFF_MAX_MS 30000
+#define TARGET_WATCH_CHANNEL "spheremon:watchthread:"
+
+typedef struct Target
+{
+    char name[TARGET_NAME_LEN];
+    char host[TARGET_HOST_LEN];
+    char port[TARGET_PORT_LEN];
+    char pass[TARGET_PASS_LEN];
+    char subscribePattern[CONFIG_PATTERN_LEN];
+    size_t keyPatternCount;
+    char keyPatterns[CONFIG_MAX_PATTERNS][CONFIG_PATTERN_LEN];
+
+    // sweep loop only
+    RedisConnection_t sweepConn;
+    RedisArray_t* keySets[CONFIG_MAX_PATTERNS];
+    size_t keySetCount;
+    bool keysLoaded;
+    uint64_t keysGeneration;        // Config_t keysGeneration of the last load
+    bool connectedOnce;
+    uint64_t retryAtMs;
+    uint32_t backoffMs;
+
+    // a fresh subscription moves from the sweep loop to the activity loop
+    // through handoff; subUp stays set until the activity loop loses it
+    _Atomic int handoff;
+    _Atomic bool subUp;
+    _Atomic bool sweepUp;           // sweepConn is open, for TargetSet_format
+
+    // activity loop only
+    RedisConnection_t subConn;
+    Resp3Reader_t* reader;
+
+    // watch thread only
+    uint64_t watchLast;
+
+    KeyTable_t keys;
+    _Atomic uint64_t msgCount;
+    _Atomic uint32_t reconnects;
+    _Atomic uint64_t activityNs;    // thread CPU time spent on this target
+    _Atomic uint64_t sweepNs;
+} Target_t;
+
+typedef struct TargetSet
+{
+    Target_t targets[TARGET_MAX];
+    size_t count;
+    volatile sig_atomic_t* running;
+} TargetSet_t;
+
+void TargetSet_init(TargetSet_t* set, volatile sig_atomic_t* running);
+
+// Parses spec (see above) into a new target; false if malformed or full.
+bool TargetSet_add(TargetSet_t* set, const char* spec, const Config_t* defaults);
+
+Target_t* TargetSet_find(TargetSet_t* set, const char* name);
+
+// Thread entry points; arg is the TargetSet_t*.
+void* TargetSet_activityFunc(void* arg);
+void* TargetSet_sweepFunc(void* arg);
+
+// "<name> up|down msgs=N tracked=N lost=N reconnects=N cpu=Xms/Yms mem=NB; ..."
+size_t TargetSet_format(TargetSet_t* set, char* buf, size_t bufLen);
+
+// The watch thread's per-interval line for one target.
+size_t Target_formatWatch(Target_t* target, uint64_t uptime, double intervalSeconds, char* buf, size_t bufLen);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdio.h>
+
+// Shared by the unit tests: CHECK records a failure and carries on, so one
+// run reports every broken check; main ends with return Check_report(name).
+
+static int failures;
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static inline int Check_report(const char* name)
+{
+    if (failures)
+    {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
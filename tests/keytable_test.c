@@ -0,0 +1,86 @@
+// Pages through KeyTable_formatLost() at the edges: a key 0 that doesn't fit,
+// a limit of 0, and a name longer than the whole reply.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "keytable.h"
+
+#define KEY_COUNT 40
+
+static char names[KEY_COUNT][128];
+static RedisObject_t objects[KEY_COUNT];
+static RedisArray_t set = { .count = KEY_COUNT, .objects = objects };
+
+static void buildTable(KeyTable_t* table)
+{
+    for (size_t i = 0; i < KEY_COUNT; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "key:%zu", i);
+        objects[i].type = RedisObjectType_BulkString;
+        objects[i].obj = names[i];
+    }
+    // key 0 and key 34 are far longer than the rest
+    memset(names[0] + 4, 'x', 100);
+    names[0][104] = '\0';
+    memset(names[34] + 5, 'y', 100);
+    names[34][105] = '\0';
+
+    RedisArray_t* sets[] = { &set };
+    KeyTable_init(table);
+    CHECK(KeyTable_rebuild(table, sets, 1));
+}
+
+// Pages through every lost key, returning how many names came back; calls is
+// bounded so a cursor that stops advancing fails instead of spinning.
+static size_t pageAll(KeyTable_t* table, size_t limit, size_t outLen, size_t* calls)
+{
+    char* out = (char*)malloc(outLen);
+    size_t cursor = 0, total = 0;
+    for (*calls = 0; *calls < 4 * KEY_COUNT; )
+    {
+        total += KeyTable_formatLost(table, cursor, limit, out, outLen);
+        ++*calls;
+
+        size_t lost, next;
+        CHECK(sscanf(out, "%zu %zu", &lost, &next) == 2);
+        if (!next)
+            break;
+        CHECK(next > cursor);
+        cursor = next;
+    }
+    free(out);
+    return total;
+}
+
+int main(void)
+{
+    KeyTable_t table;
+    buildTable(&table);
+    for (size_t i = 0; i < KEY_COUNT; i += 3)
+        KeyTable_setLost(&table, i, true);
+    KeyTable_setLost(&table, 34, true);
+    const size_t lost = (KEY_COUNT + 2) / 3 + 1;
+
+    size_t calls;
+    // roomy reply: everything in one go
+    CHECK(pageAll(&table, 500, 4096, &calls) == lost);
+    CHECK(calls == 1);
+
+    // limit 0 still makes progress, one key per call
+    CHECK(pageAll(&table, 0, 4096, &calls) == lost);
+    CHECK(calls == lost);
+
+    // key 0 and key 34 can never fit: they're skipped, the rest still page
+    CHECK(pageAll(&table, 500, 96, &calls) == lost - 2);
+    CHECK(calls < 4 * KEY_COUNT);
+
+    // a stopped page must not append names past its resume point
+    char out[96];
+    CHECK(KeyTable_formatLost(&table, 3, 2, out, sizeof(out)) == 2);
+    CHECK(!strcmp(out, "15 9 key:3 key:6"));
+
+    return Check_report("keytable");
+}
@@ -0,0 +1,107 @@
+// Round-trips metrics frames through the codec, including a consumer that
+// misses a frame and must resync on the next key frame.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "metricsframe.h"
+
+static MetricsFrame_t sample(unsigned i)
+{
+    MetricsFrame_t f = {
+        .perSecX100 = 1000 + i,
+        .curPerSecX100 = 900 + i,
+        .uptime = 5 * (uint64_t)i,
+        .msgCount = 50 * (uint64_t)i,
+        .intervalCount = 50,
+        .trackedKeys = 8,
+        .lostKeys = i % 3
+    };
+    return f;
+}
+
+static void checkSame(const MetricsFrame_t* a, const MetricsFrame_t* b)
+{
+    CHECK(a->seq == b->seq);
+    CHECK(a->perSecX100 == b->perSecX100);
+    CHECK(a->curPerSecX100 == b->curPerSecX100);
+    CHECK(a->uptime == b->uptime);
+    CHECK(a->msgCount == b->msgCount);
+    CHECK(a->intervalCount == b->intervalCount);
+    CHECK(a->trackedKeys == b->trackedKeys);
+    CHECK(a->lostKeys == b->lostKeys);
+}
+
+static void testRoundTrip(void)
+{
+    MetricsFrameCodec_t enc, dec;
+    MetricsFrameCodec_init(&enc);
+    MetricsFrameCodec_init(&dec);
+
+    for (unsigned i = 0; i < 3 * METRICS_FRAME_KEY_INTERVAL; i++)
+    {
+        uint8_t buf[METRICS_FRAME_MAX_SIZE];
+        MetricsFrame_t in = sample(i), out;
+        size_t len = MetricsFrame_encode(&enc, &in, buf, sizeof(buf));
+        CHECK(len > 0);
+        CHECK(MetricsFrame_decode(&dec, buf, len, &out) == (int)len);
+        checkSame(&in, &out);
+    }
+}
+
+static void testDroppedFrame(void)
+{
+    MetricsFrameCodec_t enc, dec;
+    MetricsFrameCodec_init(&enc);
+    MetricsFrameCodec_init(&dec);
+
+    const unsigned dropped = 3;
+    unsigned resynced = 0;
+    for (unsigned i = 0; i < 2 * METRICS_FRAME_KEY_INTERVAL; i++)
+    {
+        uint8_t buf[METRICS_FRAME_MAX_SIZE];
+        MetricsFrame_t in = sample(i), out;
+        size_t len = MetricsFrame_encode(&enc, &in, buf, sizeof(buf));
+        if (i == dropped)
+            continue;
+
+        int rc = MetricsFrame_decode(&dec, buf, len, &out);
+        if (i > dropped && i < METRICS_FRAME_KEY_INTERVAL)
+        {
+            // every delta up to the next key frame has lost its base
+            CHECK(rc == MetricsFrameError_NeedKeyFrame);
+            continue;
+        }
+
+        CHECK(rc == (int)len);
+        checkSame(&in, &out);
+        if (i >= METRICS_FRAME_KEY_INTERVAL)
+            resynced++;
+    }
+    CHECK(resynced == METRICS_FRAME_KEY_INTERVAL);
+}
+
+static void testDeltaBeforeKey(void)
+{
+    MetricsFrameCodec_t enc, dec;
+    MetricsFrameCodec_init(&enc);
+    MetricsFrameCodec_init(&dec);
+
+    uint8_t buf[METRICS_FRAME_MAX_SIZE];
+    MetricsFrame_t in = sample(0), out;
+    MetricsFrame_encode(&enc, &in, buf, sizeof(buf));
+    in = sample(1);
+    size_t len = MetricsFrame_encode(&enc, &in, buf, sizeof(buf));
+    CHECK(MetricsFrame_decode(&dec, buf, len, &out) == MetricsFrameError_NeedKeyFrame);
+    CHECK(MetricsFrame_decode(&dec, buf, METRICS_FRAME_MAX_SIZE / 8, &out) == MetricsFrameError_Truncated);
+}
+
+int main(void)
+{
+    testRoundTrip();
+    testDroppedFrame();
+    testDeltaBeforeKey();
+
+    return Check_report("metricsframe");
+}
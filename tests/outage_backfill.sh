@@ -0,0 +1,113 @@
+#!/bin/sh
+# End-to-end outage test for the watch thread's spool (spool.h): runs
+# spheremon against a scratch redis-server, kills redis for OUTAGE_SECONDS,
+# restarts it and checks what was backfilled.
+#
+#   tests/outage_backfill.sh path/to/spheremon
+#
+# The backfill list is preloaded with SPOOL_BACKFILL_KEEP filler entries and
+# saved, so the restarted redis comes back with a full list. Passes if,
+# once the spool has drained:
+#   - the list is exactly SPOOL_BACKFILL_KEEP long (LTRIM kept the newest),
+#   - the outage's frames sit after every filler, at least OUTAGE_SECONDS - 2
+#     of them, with uptimes one watch interval apart (in order, no gaps).
+#
+# Needs redis-server and redis-cli on PATH and a text-frame build
+# (METRICS_BINARY_FRAMES=0); exits 77, which ctest reports as skipped,
+# without them. The port can be moved with PORT.
+
+set -e
+
+SPHEREMON=${1:?usage: $0 path/to/spheremon}
+PORT=${PORT:-6393}
+OUTAGE_SECONDS=${OUTAGE_SECONDS:-8}
+LAB=$(mktemp -d "${TMPDIR:-/tmp}/spheremon-outage.XXXXXX")
+HERE=$(cd "$(dirname "$0")" && pwd)
+KEY=spheremon:watchthread:backfill
+KEEP=$(sed -n 's/^#define SPOOL_BACKFILL_KEEP *\([0-9]*\).*/\1/p' "$HERE/../spheremon/spool.h")
+
+if ! command -v redis-server >/dev/null || ! command -v redis-cli >/dev/null; then
+    echo "outage_backfill: redis-server/redis-cli not on PATH, skipping"
+    exit 77
+fi
+
+cli() {
+    redis-cli -p "$PORT" "$@"
+}
+
+start_redis() {
+    redis-server --port "$PORT" --dir "$LAB" --dbfilename dump.rdb --save "" --appendonly no \
+        --daemonize yes --pidfile "$LAB/redis.pid" --logfile "$LAB/redis.log"
+    for _ in 1 2 3 4 5 6 7 8 9 10; do
+        cli PING >/dev/null 2>&1 && return 0
+        sleep 0.2
+    done
+    echo "outage_backfill: redis-server didn't start" >&2
+    exit 1
+}
+
+cleanup() {
+    [ -n "$SM_PID" ] && kill "$SM_PID" 2>/dev/null && wait "$SM_PID" 2>/dev/null
+    [ -f "$LAB/redis.pid" ] && kill "$(cat "$LAB/redis.pid")" 2>/dev/null
+    rm -rf "$LAB"
+}
+trap cleanup EXIT
+
+fail() {
+    echo "outage_backfill: FAIL: $*" >&2
+    echo "--- spheremon log (tail) ---" >&2
+    tail -20 "$LAB/spheremon.log" >&2
+    exit 1
+}
+
+start_redis
+"$SPHEREMON" 127.0.0.1 "$PORT" > "$LAB/spheremon.log" 2>&1 &
+SM_PID=$!
+
+# up once the command thread has subscribed; then tick every second
+for _ in $(seq 50); do
+    [ "$(cli PUBSUB NUMSUB spheremon:command | sed -n 2p)" = 1 ] && break
+    sleep 0.2
+done
+[ "$(cli PUBSUB NUMSUB spheremon:command | sed -n 2p)" = 1 ] || fail "spheremon never subscribed"
+cli PUBLISH spheremon:command "set-watch-interval 1" >/dev/null
+sleep 6
+
+cli EVAL "for i = 1, tonumber(ARGV[1]) do redis.call('RPUSH', KEYS[1], 'filler') end" 1 "$KEY" "$KEEP" >/dev/null
+cli SAVE >/dev/null
+
+echo "outage_backfill: killing redis for ${OUTAGE_SECONDS}s"
+kill -9 "$(cat "$LAB/redis.pid")"
+rm -f "$LAB/redis.pid"
+sleep "$OUTAGE_SECONDS"
+start_redis
+
+# the watch thread reconnects within its backoff and replays a few batches
+# per tick; wait for the list to stop growing
+prev=-1
+for _ in $(seq 60); do
+    sleep 1
+    frames=$(cli LRANGE "$KEY" 0 -1 | grep -vc '^filler$' || true)
+    [ "$frames" -gt 0 ] && [ "$frames" = "$prev" ] && break
+    prev=$frames
+done
+
+len=$(cli LLEN "$KEY")
+cli LRANGE "$KEY" 0 -1 > "$LAB/backfill.txt"
+
+[ "$len" = "$KEEP" ] || fail "backfill list is $len long, expected the LTRIM bound $KEEP"
+[ "$frames" -ge $((OUTAGE_SECONDS - 2)) ] || fail "only $frames frames backfilled for a ${OUTAGE_SECONDS}s outage"
+
+# every filler first, then only frames, whose uptimes step by one interval
+awk '
+    /^filler$/ { if (seen) { print "filler after a frame at line " NR; bad = 1 } next }
+    {
+        seen++
+        if (!match($0, /^\[[0-9]+\]/)) { print "not a text frame: " $0; bad = 1; next }
+        uptime = substr($0, 2, RLENGTH - 2) + 0
+        if (seen > 1 && uptime != last + 1) { print "uptime " uptime " after " last; bad = 1 }
+        last = uptime
+    }
+    END { exit bad }' "$LAB/backfill.txt" || fail "backfilled frames out of order"
+
+echo "outage_backfill: ok ($frames frames from a ${OUTAGE_SECONDS}s outage, list held at $len)"
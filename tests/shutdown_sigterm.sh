@@ -0,0 +1,68 @@
+#!/bin/sh
+# SIGTERM latency of the real spheremon, from the signal to process exit.
+#
+#   tests/shutdown_sigterm.sh path/to/spheremon [bound-ms]
+#
+# With redis-server on PATH, spheremon runs against a scratch instance and
+# is signalled once fully initialized, so every thread is in its steady
+# state: blocked on a subscription, in a cadence or watch sleep, in poll().
+# Without one, it is pointed at a closed port and signalled while every
+# connection is in reconnect backoff. Either way it must exit 0 within
+# bound-ms (default 100). A connect still in flight isn't woken (see
+# Shutdown_cutTracked), so the closed port is on loopback, where connects
+# fail at once. The port can be moved with PORT.
+
+set -e
+
+SPHEREMON=${1:?usage: $0 path/to/spheremon [bound-ms]}
+BOUND_MS=${2:-100}
+PORT=${PORT:-6394}
+LAB=$(mktemp -d "${TMPDIR:-/tmp}/spheremon-sigterm.XXXXXX")
+
+cleanup() {
+    [ -n "$SM_PID" ] && kill -9 "$SM_PID" 2>/dev/null
+    [ -f "$LAB/redis.pid" ] && kill "$(cat "$LAB/redis.pid")" 2>/dev/null
+    rm -rf "$LAB"
+}
+trap cleanup EXIT
+
+fail() {
+    echo "shutdown_sigterm: FAIL: $*" >&2
+    echo "--- spheremon log (tail) ---" >&2
+    tail -20 "$LAB/spheremon.log" >&2
+    exit 1
+}
+
+if command -v redis-server >/dev/null; then
+    mode="against redis-server"
+    ready="spheremon fully initialized"
+    redis-server --port "$PORT" --dir "$LAB" --save "" --appendonly no \
+        --daemonize yes --pidfile "$LAB/redis.pid" --logfile "$LAB/redis.log"
+    sleep 0.5
+else
+    mode="without redis (reconnect backoff)"
+    ready="connection failed, retrying"
+fi
+
+"$SPHEREMON" 127.0.0.1 "$PORT" > "$LAB/spheremon.log" 2>&1 &
+SM_PID=$!
+
+for _ in $(seq 100); do
+    grep -q "$ready" "$LAB/spheremon.log" && break
+    kill -0 "$SM_PID" 2>/dev/null || fail "spheremon exited before it was up"
+    sleep 0.1
+done
+grep -q "$ready" "$LAB/spheremon.log" || fail "spheremon never got to '$ready'"
+# let every thread settle into its wait
+sleep 1
+
+start=$(date +%s%N)
+kill -TERM "$SM_PID"
+status=0
+wait "$SM_PID" || status=$?
+elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+SM_PID=
+
+[ "$status" = 0 ] || fail "exit status $status after SIGTERM"
+[ "$elapsed" -le "$BOUND_MS" ] || fail "took ${elapsed}ms to exit, bound ${BOUND_MS}ms"
+echo "shutdown_sigterm: ok, $mode: exited ${elapsed}ms after SIGTERM (bound ${BOUND_MS}ms)"
@@ -0,0 +1,144 @@
+// Drives the watch thread's metrics spool through a redis outage: samples are
+// spooled while the transport is down, a reconnect backfills them in order,
+// and a link that drops mid-backfill loses nothing.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "spool.h"
+
+// stands in for redis: applies RPUSH/LTRIM on SPOOL_BACKFILL_KEY to a list
+typedef struct FakeRedis
+{
+    bool up;
+    int failAfter;          // requests accepted before the link drops; < 0 for never
+    char list[SPOOL_BACKFILL_KEEP + SPOOL_BACKFILL_BATCH][SPOOL_MAX_RECORD + 1];
+    size_t listLen;
+} FakeRedis_t;
+
+static size_t parseArray(const char* buf, size_t len, char args[][SPOOL_MAX_RECORD + 1], size_t maxArgs)
+{
+    const char* p = buf;
+    size_t n = strtoul(p + 1, (char**)&p, 10);
+    p += 2;
+    for (size_t i = 0; i < n && i < maxArgs; i++)
+    {
+        size_t argLen = strtoul(p + 1, (char**)&p, 10);
+        p += 2;
+        memcpy(args[i], p, argLen);
+        args[i][argLen] = '\0';
+        p += argLen + 2;
+    }
+    if ((size_t)(p - buf) != len)
+        failures++;
+    return n;
+}
+
+static bool fakeTransport(void* ctx, const char* buf, size_t len, size_t replyCount)
+{
+    FakeRedis_t* r = (FakeRedis_t*)ctx;
+    CHECK(replyCount == 1);
+    if (!r->up || !r->failAfter)
+    {
+        r->up = false;
+        return false;
+    }
+    if (r->failAfter > 0)
+        r->failAfter--;
+
+    static char args[2 + SPOOL_BACKFILL_BATCH][SPOOL_MAX_RECORD + 1];
+    size_t n = parseArray(buf, len, args, 2 + SPOOL_BACKFILL_BATCH);
+    CHECK(!strcmp(args[1], SPOOL_BACKFILL_KEY));
+    if (!strcmp(args[0], "RPUSH"))
+    {
+        for (size_t i = 2; i < n; i++)
+            strcpy(r->list[r->listLen++], args[i]);
+    }
+    else if (!strcmp(args[0], "LTRIM") && r->listLen > SPOOL_BACKFILL_KEEP)
+    {
+        size_t drop = r->listLen - SPOOL_BACKFILL_KEEP;
+        memmove(r->list, r->list + drop, SPOOL_BACKFILL_KEEP * sizeof(r->list[0]));
+        r->listLen = SPOOL_BACKFILL_KEEP;
+    }
+    return true;
+}
+
+static void sampleLine(char* buf, size_t bufLen, unsigned tick)
+{
+    snprintf(buf, bufLen, "[%06u] %-6u %-6u %-3u %5.2f %5.2f ", tick * 5, tick * 50, (tick - 1) * 50, 50, 10.0, 10.0);
+}
+
+static void testOutageAndBackfill(void)
+{
+    static Spool_t spool;
+    static FakeRedis_t redis;
+    Spool_init(&spool);
+    memset(&redis, 0, sizeof(redis));
+    redis.failAfter = -1;
+
+    // outage: every sample lands in the spool
+    const unsigned outageTicks = 150;
+    char line[64];
+    for (unsigned t = 1; t <= outageTicks; t++)
+    {
+        sampleLine(line, sizeof(line), t);
+        CHECK(Spool_push(&spool, line, strlen(line)));
+    }
+    CHECK(spool.count == outageTicks);
+    CHECK(spool.evicted == 0);
+    CHECK(!Spool_backfill(&spool, fakeTransport, &redis));
+    CHECK(spool.count == outageTicks);
+
+    // redis is back but drops after one batch: only acknowledged records leave
+    redis.up = true;
+    redis.failAfter = 1;
+    CHECK(!Spool_backfill(&spool, fakeTransport, &redis));
+    CHECK(redis.listLen == SPOOL_BACKFILL_BATCH);
+    CHECK(spool.count == outageTicks - SPOOL_BACKFILL_BATCH);
+
+    // reconnect: the rest drains in order
+    redis.up = true;
+    redis.failAfter = -1;
+    for (int tick = 0; tick < 4 && spool.count; tick++)
+        CHECK(Spool_backfill(&spool, fakeTransport, &redis));
+    CHECK(spool.count == 0);
+    CHECK(redis.listLen == outageTicks);
+    for (unsigned t = 1; t <= outageTicks && t <= redis.listLen; t++)
+    {
+        sampleLine(line, sizeof(line), t);
+        CHECK(!strcmp(redis.list[t - 1], line));
+    }
+}
+
+static void testEvictsOldest(void)
+{
+    static Spool_t spool;
+    Spool_init(&spool);
+
+    char rec[SPOOL_MAX_RECORD];
+    const size_t perRec = sizeof(rec) + 1, fits = SPOOL_BYTES / perRec;
+    for (unsigned i = 0; i < fits + 3; i++)
+    {
+        memset(rec, 'a' + i % 26, sizeof(rec));
+        CHECK(Spool_push(&spool, rec, sizeof(rec)));
+    }
+    CHECK(spool.count == fits);
+    CHECK(spool.evicted == 3);
+
+    uint8_t scratch[SPOOL_MAX_RECORD];
+    const char* recs[1];
+    size_t lens[1];
+    CHECK(Spool_peek(&spool, scratch, sizeof(scratch), recs, lens, 1) == 1);
+    CHECK(lens[0] == sizeof(rec) && recs[0][0] == 'a' + 3);
+    CHECK(!Spool_push(&spool, rec, SPOOL_MAX_RECORD + 1));
+}
+
+int main(void)
+{
+    testOutageAndBackfill();
+    testEvictsOldest();
+
+    return Check_report("spool");
+}
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Generates commandhash.h: a collision-free hash of the command names in
+commands.def, so Command_lookup() is one hash, one table load and one
+compare regardless of how many commands exist.
+
+Usage: gen_commandhash.py commands.def commandhash.h
+"""
+import re
+import sys
+
+MASK32 = 0xFFFFFFFF
+EMPTY = 0xFF
+
+
+def command_hash(seed, name):
+    # must match Command_hash() in commands.c
+    h = 2166136261 ^ seed
+    for b in name.encode():
+        h ^= b
+        h = (h * 16777619) & MASK32
+    return h ^ (h >> 15)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    names = re.findall(r'^\s*COMMAND\(\s*"([^"]+)"', open(sys.argv[1]).read(), re.M)
+    if len(set(names)) != len(names):
+        sys.exit("duplicate command names in " + sys.argv[1])
+    if len(names) >= EMPTY:
+        sys.exit("too many commands for 8-bit slots")
+
+    size = 1
+    while size < 2 * len(names):
+        size *= 2
+
+    for seed in range(1 << 24):
+        slots = [EMPTY] * size
+        for i, name in enumerate(names):
+            s = command_hash(seed, name) & (size - 1)
+            if slots[s] != EMPTY:
+                break
+            slots[s] = i
+        else:
+            break
+    else:
+        sys.exit("no perfect hash seed found")
+
+    rows = ", ".join(str(s) for s in slots)
+    with open(sys.argv[2], "w") as out:
+        out.write(f"""#pragma once
+
+// Generated by tools/gen_commandhash.py from commands.def; do not edit.
+
+#include <stdint.h>
+
+#define COMMAND_HASH_SEED {seed}u
+#define COMMAND_HASH_MASK {size - 1}u
+#define COMMAND_HASH_COUNT {len(names)}
+#define COMMAND_HASH_EMPTY {EMPTY}
+
+static const uint8_t CommandHashSlots[{size}] = {{ {rows} }};
+""")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,69 @@
+#!/bin/sh
+# Local failover lab for spheremon's sentinel mode: a primary, a replica and
+# one sentinel on loopback, all in a scratch directory.
+#
+#   tools/sentinel_lab.sh up        start everything, print the spheremon args
+#   tools/sentinel_lab.sh failover  force a failover and show the new primary
+#   tools/sentinel_lab.sh down      stop everything and remove the scratch dir
+#
+# Needs redis-server and redis-cli on PATH (redis-sentinel is redis-server
+# --sentinel). Ports can be moved with PRIMARY_PORT, REPLICA_PORT and
+# SENTINEL_PORT.
+
+set -e
+
+LAB=${LAB:-/tmp/spheremon-sentinel-lab}
+MASTER=${MASTER:-spheremon}
+PRIMARY_PORT=${PRIMARY_PORT:-6390}
+REPLICA_PORT=${REPLICA_PORT:-6391}
+SENTINEL_PORT=${SENTINEL_PORT:-26390}
+
+current_primary() {
+    redis-cli -p "$SENTINEL_PORT" SENTINEL get-master-addr-by-name "$MASTER" | paste -sd: -
+}
+
+case "$1" in
+up)
+    mkdir -p "$LAB"
+    redis-server --port "$PRIMARY_PORT" --dir "$LAB" --dbfilename p.rdb \
+        --daemonize yes --pidfile "$LAB/primary.pid" --logfile "$LAB/primary.log"
+    redis-server --port "$REPLICA_PORT" --dir "$LAB" --dbfilename r.rdb \
+        --replicaof 127.0.0.1 "$PRIMARY_PORT" \
+        --daemonize yes --pidfile "$LAB/replica.pid" --logfile "$LAB/replica.log"
+    cat > "$LAB/sentinel.conf" <<EOF
+port $SENTINEL_PORT
+daemonize yes
+pidfile $LAB/sentinel.pid
+logfile $LAB/sentinel.log
+sentinel monitor $MASTER 127.0.0.1 $PRIMARY_PORT 1
+sentinel down-after-milliseconds $MASTER 2000
+sentinel failover-timeout $MASTER 10000
+EOF
+    redis-server "$LAB/sentinel.conf" --sentinel
+    sleep 1
+    echo "primary: $(current_primary)"
+    echo "run:     spheremon sentinel:$MASTER 127.0.0.1:$SENTINEL_PORT"
+    ;;
+failover)
+    before=$(current_primary)
+    echo "before:  $before"
+    redis-cli -p "$SENTINEL_PORT" SENTINEL failover "$MASTER"
+    # the switch is announced once the replica has been promoted
+    for _ in 1 2 3 4 5 6 7 8 9 10; do
+        sleep 1
+        now=$(current_primary)
+        [ "$now" != "$before" ] && break
+    done
+    echo "after:   $now"
+    ;;
+down)
+    for p in sentinel replica primary; do
+        [ -f "$LAB/$p.pid" ] && kill "$(cat "$LAB/$p.pid")" 2>/dev/null || true
+    done
+    rm -rf "$LAB"
+    ;;
+*)
+    echo "usage: $0 up|failover|down" >&2
+    exit 1
+    ;;
+esac
@@ -0,0 +1,124 @@
+// Dumps spheremon binary metrics frames (see spheremon/metricsframe.h) as text.
+//
+// Reads concatenated raw frames from stdin, or with -x one hex-encoded frame
+// per line (e.g. from a subscriber script). Build on any host with:
+//   cc -I../spheremon -o smframedump smframedump.c ../spheremon/metricsframe.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "metricsframe.h"
+
+static const char* errorString(int err)
+{
+    switch (err)
+    {
+    case MetricsFrameError_Truncated: return "truncated frame";
+    case MetricsFrameError_Version: return "unsupported frame version";
+    case MetricsFrameError_NeedKeyFrame: return "delta frame before a key frame or after a dropped frame";
+    default: return "unknown error";
+    }
+}
+
+static void dumpFrame(const MetricsFrame_t* f, int len)
+{
+    char line[160];
+    MetricsFrame_format(f, line, sizeof(line));
+    printf("seq=%-5u len=%-2d keys=%llu/%llu %s\n", (unsigned)f->seq, len,
+        (unsigned long long)(f->trackedKeys - f->lostKeys), (unsigned long long)f->trackedKeys, line);
+}
+
+static int dumpRaw(FILE* in)
+{
+    size_t cap = 4096, len = 0;
+    uint8_t* buf = (uint8_t*)malloc(cap);
+    size_t n;
+    while (buf && (n = fread(buf + len, 1, cap - len, in)) > 0)
+    {
+        len += n;
+        if (len == cap)
+        {
+            uint8_t* grown = (uint8_t*)realloc(buf, cap * 2);
+            if (!grown)
+            {
+                free(buf);
+                return 1;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+
+    if (!buf)
+        return 1;
+
+    MetricsFrameCodec_t codec;
+    MetricsFrameCodec_init(&codec);
+    MetricsFrame_t frame;
+    size_t off = 0;
+    int rc = 0;
+    while (off < len)
+    {
+        int used = MetricsFrame_decode(&codec, buf + off, len - off, &frame);
+        if (used < 0)
+        {
+            fprintf(stderr, "offset %zu: %s\n", off, errorString(used));
+            rc = 1;
+            break;
+        }
+        dumpFrame(&frame, used);
+        off += (size_t)used;
+    }
+
+    free(buf);
+    return rc;
+}
+
+static int dumpHex(FILE* in)
+{
+    MetricsFrameCodec_t codec;
+    MetricsFrameCodec_init(&codec);
+    char line[512];
+    uint8_t frameBuf[METRICS_FRAME_MAX_SIZE];
+    int lineNo = 0, rc = 0;
+
+    while (fgets(line, sizeof(line), in))
+    {
+        size_t n = 0;
+        unsigned byte;
+        ++lineNo;
+        for (char* p = line; n < sizeof(frameBuf) && isxdigit((unsigned char)p[0]) && isxdigit((unsigned char)p[1]); p += 2)
+        {
+            sscanf(p, "%2x", &byte);
+            frameBuf[n++] = (uint8_t)byte;
+        }
+
+        if (!n)
+            continue;
+
+        MetricsFrame_t frame;
+        int used = MetricsFrame_decode(&codec, frameBuf, n, &frame);
+        if (used < 0)
+        {
+            fprintf(stderr, "line %d: %s\n", lineNo, errorString(used));
+            rc = 1;
+            continue;
+        }
+        dumpFrame(&frame, used);
+    }
+
+    return rc;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-x"))
+    {
+        fprintf(stderr, "Usage: %s [-x] < frames\n\n", argv[0]);
+        exit(-1);
+    }
+
+    return argc > 1 ? dumpHex(stdin) : dumpRaw(stdin);
+}